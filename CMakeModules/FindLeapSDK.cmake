@@ -10,6 +10,12 @@
 #
 # Created by Johannes Kroeger. 
 
+# Set up by the top level CMakeLists.txt
+IF(OSGLEAP_USE_LEAPSDK_SHIM)
+    SET(LEAP_FOUND "YES")
+    RETURN()
+ENDIF(OSGLEAP_USE_LEAPSDK_SHIM)
+
 FIND_PATH(LEAP_INCLUDE_DIR Leap.h
     $ENV{LEAPSDK_DIR}/include
     $ENV{LEAPSDK_DIR}
@@ -15,8 +15,13 @@
 
 #include <osgLeap/OrbitManipulator>
 #include <osgLeap/HandState>
+#include <osgLeap/HandSkeleton>
+#include <osgLeap/PagingPrefetcher>
+#include <osgLeap/QualityGovernor>
+#include <osgLeap/SensorImageStream>
 
 
+#include <osg/Geometry>
 #include <osg/io_utils>
 #include <osg/Material>
 #include <osg/PositionAttitudeTransform>
@@ -44,6 +49,10 @@ int main(int argc, char** argv)
     arguments.getApplicationUsage()->addCommandLineOption("--twohanded", "Initialize the OrbitManipulator in two-handed mode. PAN: One hand, ZOOM: Left hand closed+Right hand open, ROTATE: Both hands open. Move right hand for rotation (default).");
     arguments.getApplicationUsage()->addCommandLineOption("--singlehanded", "Initialize the OrbitManipulator in simple one-handed mode (rotate+zoom) without panning.");
     arguments.getApplicationUsage()->addCommandLineOption("--trackball", "Initialize the OrbitManipulator in trackball one-handed mode. Imagine to hold a basketball in your hand palm down (pan+rotate+zoom).");
+    arguments.getApplicationUsage()->addCommandLineOption("--adaptivequality", "Lower level of detail while manipulating to keep a steady frame rate.");
+    arguments.getApplicationUsage()->addCommandLineOption("--prefetch", "Request PagedLOD tiles along the camera path predicted from your hand movement.");
+    arguments.getApplicationUsage()->addCommandLineOption("--skeleton", "Show the tracked hands as 3D skeletons in front of the scene.");
+    arguments.getApplicationUsage()->addCommandLineOption("--sensorimages", "Show the images of the Leap Motion's cameras in the lower left corner.");
 
     osgViewer::Viewer viewer;
 
@@ -80,6 +89,26 @@ int main(int argc, char** argv)
         mode = osgLeap::OrbitManipulator::Trackball;
     }
 
+    bool adaptiveQuality = false;
+    while (arguments.read("--adaptivequality")) {
+        adaptiveQuality = true;
+    }
+
+    bool prefetch = false;
+    while (arguments.read("--prefetch")) {
+        prefetch = true;
+    }
+
+    bool skeleton = false;
+    while (arguments.read("--skeleton")) {
+        skeleton = true;
+    }
+
+    bool sensorImages = false;
+    while (arguments.read("--sensorimages")) {
+        sensorImages = true;
+    }
+
 	osg::ref_ptr<osgLeap::OrbitManipulator> om = new osgLeap::OrbitManipulator(mode);
 	om->setModifierKey('p');
 	om->setModifierMode(osgLeap::OrbitManipulator::MM_SIMPLE);
@@ -104,7 +133,58 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    viewer.setSceneData( loadedModel.get() );
+    osg::ref_ptr<osg::Group> root = new osg::Group();
+    root->addChild(loadedModel.get());
+    viewer.setSceneData( root.get() );
+
+    if (skeleton) {
+        // Look at the tracking volume above the device from a fixed position,
+        // independent of the manipulated camera
+        osg::ref_ptr<osg::Camera> skeletonCamera = new osg::Camera();
+        skeletonCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+        skeletonCamera->setRenderOrder(osg::Camera::POST_RENDER);
+        skeletonCamera->setClearMask(GL_DEPTH_BUFFER_BIT);
+        skeletonCamera->setProjectionMatrixAsPerspective(40.0, 1.333, 10.0, 2000.0);
+        skeletonCamera->setViewMatrixAsLookAt(osg::Vec3(0.0f, 350.0f, 600.0f), osg::Vec3(0.0f, 200.0f, 0.0f), osg::Y_AXIS);
+        skeletonCamera->addChild(new osgLeap::HandSkeleton());
+        root->addChild(skeletonCamera.get());
+    }
+
+    if (sensorImages) {
+        // Both camera images side by side, drawn on top of the scene
+        osg::ref_ptr<osg::Camera> imageCamera = new osg::Camera();
+        imageCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+        imageCamera->setRenderOrder(osg::Camera::POST_RENDER);
+        imageCamera->setClearMask(GL_DEPTH_BUFFER_BIT);
+        imageCamera->setProjectionMatrixAsOrtho2D(0.0, 1.0, 0.0, 1.0);
+        imageCamera->setViewMatrix(osg::Matrix::identity());
+
+        osg::ref_ptr<osgLeap::SensorImageStream> stream = new osgLeap::SensorImageStream(2);
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+        for (unsigned int c = 0; c < osgLeap::SensorImageStream::NUM_CAMERAS; ++c) {
+            osg::Geometry* quad = osg::createTexturedQuadGeometry(osg::Vec3(0.02f+c*0.26f, 0.02f, 0.0f), osg::Vec3(0.25f, 0.0f, 0.0f), osg::Vec3(0.0f, 0.1f, 0.0f));
+            osg::StateSet* ss = quad->getOrCreateStateSet();
+            ss->setDataVariance(osg::Object::DYNAMIC);
+            ss->setTextureAttributeAndModes(0, stream->getTexture(c), osg::StateAttribute::ON);
+            ss->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+            geode->addDrawable(quad);
+        }
+        geode->addUpdateCallback(stream.get());
+        imageCamera->addChild(geode.get());
+        root->addChild(imageCamera.get());
+    }
+
+    if (prefetch) {
+        // Ask the DatabasePager for tiles before the camera gets there
+        osg::ref_ptr<osgLeap::PagingPrefetcher> pp = new osgLeap::PagingPrefetcher(om, viewer.getCamera());
+        pp->setDatabaseRequestHandler(viewer.getDatabasePager());
+        loadedModel->addUpdateCallback(pp);
+    }
+
+    if (adaptiveQuality) {
+        // Trade detail for frame rate while the hands move the camera
+        loadedModel->addUpdateCallback(new osgLeap::QualityGovernor(om, viewer.getCamera()));
+    }
 
     viewer.realize();
 
@@ -22,11 +22,14 @@
 #include <osgWidget/WindowManager>
 #include <osgWidget/ViewerEventHandlers>
 
+#include <osgLeap/FrameProcessingGraph>
 #include <osgLeap/HandState>
 #include <osgLeap/HUDCamera>
+#include <osgLeap/IngestThread>
 #include <osgLeap/PointerPositionListener>
 #include <osgLeap/PointerEventDevice>
 #include <osgLeap/PointerGraphicsUpdateCallback>
+#include <osgLeap/TargetIndex>
 
 osg::ref_ptr<osg::Node> createText()
 {
@@ -122,7 +125,40 @@ osgWidget::Box* createBox(const std::string& name, osgWidget::Box::BoxType bt) {
     return box;
 }
 
-osg::ref_ptr<osg::Camera> setupWidgets(osgViewer::Viewer* viewer)
+// Keeps the osgLeap::TargetIndex in sync with the osgWidget windows, so
+// PointerEventDevice can hit-test them without picking the scene
+class WidgetTargetsUpdateCallback: public osg::NodeCallback
+{
+public:
+    WidgetTargetsUpdateCallback(osgLeap::TargetIndex* index): index_(index) {}
+
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        osgWidget::WindowManager* wm = dynamic_cast<osgWidget::WindowManager*>(node);
+        if (wm) {
+            for (unsigned int i = 0; i < wm->getNumChildren(); ++i) {
+                osgWidget::Window* window = dynamic_cast<osgWidget::Window*>(wm->getChild(i));
+                if (!window) continue;
+
+                std::map<osgWidget::Window*, unsigned int>::iterator itr = targets_.find(window);
+                if (itr == targets_.end()) {
+                    itr = targets_.insert(std::make_pair(window, index_->addTarget(0.0f, 0.0f, 0.0f, 0.0f, MASK_2D, i, window))).first;
+                }
+                // Unchanged windows are skipped by the index
+                index_->updateTarget(itr->second, window->getX(), window->getY(),
+                    window->getX()+window->getWidth(), window->getY()+window->getHeight());
+                index_->setTargetNodeMask(itr->second, wm->getValue(i) ? MASK_2D : 0);
+            }
+        }
+        traverse(node, nv);
+    }
+
+private:
+    osg::ref_ptr<osgLeap::TargetIndex> index_;
+    std::map<osgWidget::Window*, unsigned int> targets_;
+};
+
+osg::ref_ptr<osg::Camera> setupWidgets(osgViewer::Viewer* viewer, osgLeap::TargetIndex* targetIndex)
 {   
     osg::ref_ptr<osgWidget::WindowManager> wm = new osgWidget::WindowManager(
         viewer,
@@ -166,6 +202,8 @@ osg::ref_ptr<osg::Camera> setupWidgets(osgViewer::Viewer* viewer)
 
     wm->resizeAllWindows();
 
+    wm->addUpdateCallback(new WidgetTargetsUpdateCallback(targetIndex));
+
 	return camera;
 }
 
@@ -181,9 +219,16 @@ int main(int argc, char** argv)
     arguments.getApplicationUsage()->addCommandLineOption("--time <milliseconds>", "Invoke time-based mouse clicks after <milliseconds> (Default: 3000)");
     arguments.getApplicationUsage()->addCommandLineOption("--noclick", "Initialize osgLeap::PointerEventDevice without ability to send clicks");
     arguments.getApplicationUsage()->addCommandLineOption("--useintersection", "Invoke clicks above a valid geometry, only.");
+    arguments.getApplicationUsage()->addCommandLineOption("--asyncpick", "Like --useintersection, but intersect on a worker thread.");
     arguments.getApplicationUsage()->addCommandLineOption("--screentap", "Invoke mouse clicks upon the screen tap gesture");
+    arguments.getApplicationUsage()->addCommandLineOption("--velocitytap", "Invoke mouse clicks on a fast forward stroke of the finger, without waiting for the screen tap gesture");
     arguments.getApplicationUsage()->addCommandLineOption("--mouse", "While moving pointer send mouse motion events. Clicks are sent as mouse clicks.");
     arguments.getApplicationUsage()->addCommandLineOption("--touch", "While moving pointer send touch move events. Clicks are sent as touch taps.");
+    arguments.getApplicationUsage()->addCommandLineOption("--cachedhud", "Render the HUD into a texture only when hands or pointers have changed.");
+    arguments.getApplicationUsage()->addCommandLineOption("--processinggraph", "Map pointers to the screen on worker threads as soon as a frame arrives.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ingestthread", "Receive tracking frames on a thread of osgLeap instead of the SDK's callback thread.");
+    arguments.getApplicationUsage()->addCommandLineOption("--ingestcpu <n>", "Like --ingestthread, but run the thread on CPU <n> only.");
+    arguments.getApplicationUsage()->addCommandLineOption("--latelatch", "Draw the pointers at the newest tracking data available right before the HUD is drawn.");
 
     osgViewer::Viewer viewer;
     viewer.setUpViewOnSingleScreen(0);
@@ -244,12 +289,46 @@ int main(int argc, char** argv)
         //osgLeap::Controller::instance()->controller()->enableGesture(Leap::Gesture::TYPE_SCREEN_TAP);
         clickEmulateStillStandTime = 0;
     }
+    while (arguments.read("--velocitytap")) {
+        clickMode = osgLeap::PointerEventDevice::VELOCITY_TAP;
+        clickEmulateStillStandTime = 0;
+    }
+
+    bool cachedHUD = false;
+    while (arguments.read("--cachedhud")) {
+        cachedHUD = true;
+    }
+
+    bool processingGraph = false;
+    while (arguments.read("--processinggraph")) {
+        processingGraph = true;
+    }
+
+    bool ingestThread = false;
+    int ingestCPU = -1;
+    while (arguments.read("--ingestthread")) {
+        ingestThread = true;
+    }
+    while (arguments.read("--ingestcpu", ingestCPU)) {
+        ingestThread = true;
+    }
+
+    bool lateLatching = false;
+    while (arguments.read("--latelatch")) {
+        lateLatching = true;
+    }
 
     bool useIntersection = false;
     while (arguments.read("--useintersection")) {
         useIntersection = true;
     }
 
+    bool asyncPick = false;
+    while (arguments.read("--asyncpick")) {
+        useIntersection = true;
+        asyncPick = true;
+    }
+
     // load the data
     osg::ref_ptr<osg::Node> loadedModel = osgDB::readNodeFiles(arguments);
     if (!loadedModel)
@@ -272,7 +351,8 @@ int main(int argc, char** argv)
 
     viewer.realize();
 
-	osg::Camera* hudCamera = new osgLeap::HUDCamera(viewer.getCamera());
+	osgLeap::HUDCamera* hudCamera = new osgLeap::HUDCamera(viewer.getCamera());
+	hudCamera->setCachedRendering(cachedHUD);
 
     // Adds the osgLeap::HandState visualizer
 	osg::Node* hands = new osgLeap::HandState();
@@ -286,6 +366,20 @@ int main(int argc, char** argv)
     // the remaining time until the click is executed.
 	osg::ref_ptr<osgLeap::PointerGraphicsUpdateCallback> puc = new osgLeap::PointerGraphicsUpdateCallback(viewer.getCamera(), clickEmulateStillStandTime);
     pointersGroup->addUpdateCallback(puc);
+    if (lateLatching) {
+        puc->setLateLatching(hudCamera);
+    }
+    if (processingGraph) {
+        puc->getPointerPositionListener()->setProcessingGraph(new osgLeap::FrameProcessingGraph(2));
+    }
+    osg::ref_ptr<osgLeap::IngestThread> ingest;
+    if (ingestThread) {
+        ingest = new osgLeap::IngestThread(osgLeap::IngestThread::SPIN_THEN_BLOCK);
+        ingest->attach(puc->getPointerPositionListener());
+        if (ingestCPU >= 0) ingest->setProcessorAffinity(ingestCPU);
+        ingest->setView(&viewer);
+        ingest->start();
+    }
     hudCamera->addChild(pointersGroup);
 
     // Our PointerEventDevice is initialized to fire mouseclicks after clickEmulateStillStandTime is gone
@@ -294,12 +388,16 @@ int main(int argc, char** argv)
         // Setup viewer and nodemask, so clicks will be sent only if we are hovering above some node
         dev->setView(&viewer);
         dev->setTraversalMask(0xffffffff);
+        dev->setAsyncPicking(asyncPick);
     }
 
+    // Clicks onto osgWidget windows are detected through the target index
+    dev->setTargetIndex(new osgLeap::TargetIndex());
+
     viewer.addDevice(dev);
 
     // Setup example osgWidgets
-	osg::ref_ptr<osg::Camera> widgetCamera = setupWidgets(&viewer);
+	osg::ref_ptr<osg::Camera> widgetCamera = setupWidgets(&viewer, dev->getTargetIndex());
 
 	if ((osg::DisplaySettings::instance()->getStereoMode() == osg::DisplaySettings::HORIZONTAL_SPLIT ||
 		osg::DisplaySettings::instance()->getStereoMode() == osg::DisplaySettings::VERTICAL_SPLIT) &&
@@ -0,0 +1,976 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include "Leap.h"
+
+//-- OpenThreads --//
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ReentrantMutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+//-- STL --//
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/time.h>
+#else
+#include <time.h>
+#endif
+
+namespace Leap {
+
+    //--------------------------------------------------------------------//
+    // Frame data
+    //--------------------------------------------------------------------//
+
+    struct BoneData {
+        Vector prevJoint;
+        Vector nextJoint;
+    };
+
+    struct PointableData {
+        PointableData(): id(-1), hand(-1), handID(-1), isFinger(true), fingerType(Finger::TYPE_INDEX),
+            extended(true), length(60.0f), width(18.0f) {}
+
+        int id;
+        // Index of the hand in the frame, -1 for none
+        int hand;
+        // As given by the feed, resolved to hand when the frame is complete
+        int handID;
+        bool isFinger;
+        Finger::Type fingerType;
+        bool extended;
+        Vector tip;
+        Vector tipVelocity;
+        Vector direction;
+        float length;
+        float width;
+        BoneData bones[4];
+    };
+
+    struct HandData {
+        HandData(): id(-1), left(false), grabStrength(0.0f), palmWidth(85.0f) {}
+
+        int id;
+        bool left;
+        float grabStrength;
+        float palmWidth;
+        Vector palm;
+        Vector palmVelocity;
+        Vector normal;
+        Vector direction;
+        std::vector<int> pointables;
+        std::vector<int> fingers;
+        std::vector<int> tools;
+    };
+
+    struct GestureData {
+        GestureData(): id(-1), type(Gesture::TYPE_INVALID), state(Gesture::STATE_STOP) {}
+
+        int id;
+        Gesture::Type type;
+        Gesture::State state;
+        std::vector<int> pointableIDs;
+        std::vector<int> pointables;
+    };
+
+    // Everything of a frame but its reference count, so feeds can keep
+    // copies of it
+    struct FrameContent {
+        FrameContent(): id(-1), timestamp(0), fps(0.0f), boxCenter(0.0f, 200.0f, 0.0f),
+            boxSize(235.0f, 235.0f, 147.0f) {}
+
+        long long id;
+        long long timestamp;
+        float fps;
+        Vector boxCenter;
+        Vector boxSize;
+        std::vector<HandData> hands;
+        std::vector<PointableData> pointables;
+        std::vector<GestureData> gestures;
+
+        // Filled by complete()
+        std::vector<int> handIndices;
+        std::vector<int> pointableIndices;
+        std::vector<int> fingerIndices;
+        std::vector<int> toolIndices;
+        std::vector<int> gestureIndices;
+
+        int findHand(int handID) const
+        {
+            for (unsigned int i = 0; i < hands.size(); ++i) {
+                if (hands[i].id == handID) return (int)i;
+            }
+            return -1;
+        }
+
+        int findPointable(int pointableID) const
+        {
+            for (unsigned int i = 0; i < pointables.size(); ++i) {
+                if (pointables[i].id == pointableID) return (int)i;
+            }
+            return -1;
+        }
+
+        // Links the items and derives what the feed does not provide from
+        // the previous frame
+        void complete(const FrameContent* previous)
+        {
+            const float dt = (previous != NULL && timestamp > previous->timestamp) ?
+                (float)(timestamp - previous->timestamp)*1e-6f : 0.0f;
+            fps = dt > 0.0f ? 1.0f/dt : 0.0f;
+
+            handIndices.clear();
+            pointableIndices.clear();
+            fingerIndices.clear();
+            toolIndices.clear();
+            gestureIndices.clear();
+
+            for (unsigned int i = 0; i < hands.size(); ++i) {
+                HandData& hand = hands[i];
+                hand.pointables.clear();
+                hand.fingers.clear();
+                hand.tools.clear();
+                hand.normal = hand.normal.normalized();
+                hand.direction = hand.direction.normalized();
+                hand.palmVelocity = Vector();
+                if (dt > 0.0f) {
+                    const int p = previous->findHand(hand.id);
+                    if (p >= 0) hand.palmVelocity = (hand.palm - previous->hands[p].palm)/dt;
+                }
+                handIndices.push_back((int)i);
+            }
+
+            for (unsigned int i = 0; i < pointables.size(); ++i) {
+                PointableData& pointable = pointables[i];
+                pointable.hand = pointable.isFinger ? findHand(pointable.handID) : -1;
+                pointable.direction = pointable.direction.normalized();
+                pointable.tipVelocity = Vector();
+                if (dt > 0.0f) {
+                    const int p = previous->findPointable(pointable.id);
+                    if (p >= 0) pointable.tipVelocity = (pointable.tip - previous->pointables[p].tip)/dt;
+                }
+
+                // Spread the bones along the finger, the metacarpal one
+                // reaches from the palm to the knuckle
+                const Vector& tip = pointable.tip;
+                const Vector& dir = pointable.direction;
+                const float length = pointable.length;
+                const Vector knuckle = tip - dir*length;
+                const Vector palm = pointable.hand >= 0 ? hands[pointable.hand].palm : knuckle;
+                pointable.bones[Bone::TYPE_METACARPAL].prevJoint = palm;
+                pointable.bones[Bone::TYPE_METACARPAL].nextJoint = knuckle;
+                pointable.bones[Bone::TYPE_PROXIMAL].prevJoint = knuckle;
+                pointable.bones[Bone::TYPE_PROXIMAL].nextJoint = tip - dir*(length*0.5f);
+                pointable.bones[Bone::TYPE_INTERMEDIATE].prevJoint = tip - dir*(length*0.5f);
+                pointable.bones[Bone::TYPE_INTERMEDIATE].nextJoint = tip - dir*(length*0.2f);
+                pointable.bones[Bone::TYPE_DISTAL].prevJoint = tip - dir*(length*0.2f);
+                pointable.bones[Bone::TYPE_DISTAL].nextJoint = tip;
+
+                pointableIndices.push_back((int)i);
+                if (pointable.isFinger) {
+                    fingerIndices.push_back((int)i);
+                } else {
+                    toolIndices.push_back((int)i);
+                }
+                if (pointable.hand >= 0) {
+                    HandData& hand = hands[pointable.hand];
+                    hand.pointables.push_back((int)i);
+                    (pointable.isFinger ? hand.fingers : hand.tools).push_back((int)i);
+                }
+            }
+
+            for (unsigned int i = 0; i < gestures.size(); ++i) {
+                GestureData& gesture = gestures[i];
+                gesture.pointables.clear();
+                for (std::vector<int>::const_iterator itr = gesture.pointableIDs.begin(); itr != gesture.pointableIDs.end(); ++itr) {
+                    const int p = findPointable(*itr);
+                    if (p >= 0) gesture.pointables.push_back(p);
+                }
+                gestureIndices.push_back((int)i);
+            }
+        }
+    };
+
+    struct FrameData: public FrameContent {
+        explicit FrameData(const FrameContent& content): FrameContent(content), refCount(0) {}
+
+        OpenThreads::Atomic refCount;
+    };
+
+    FrameRef::FrameRef(FrameData* data): data_(data)
+    {
+        if (data_ != NULL) ++data_->refCount;
+    }
+
+    FrameRef::FrameRef(const FrameRef& other): data_(other.data_)
+    {
+        if (data_ != NULL) ++data_->refCount;
+    }
+
+    FrameRef::~FrameRef()
+    {
+        if (data_ != NULL && --data_->refCount == 0) delete data_;
+    }
+
+    FrameRef& FrameRef::operator=(const FrameRef& other)
+    {
+        if (data_ == other.data_) return *this;
+        FrameData* previous = data_;
+        data_ = other.data_;
+        if (data_ != NULL) ++data_->refCount;
+        if (previous != NULL && --previous->refCount == 0) delete previous;
+        return *this;
+    }
+
+    namespace {
+
+        long long currentTime()
+        {
+#if defined(_WIN32)
+            LARGE_INTEGER frequency, counter;
+            QueryPerformanceFrequency(&frequency);
+            QueryPerformanceCounter(&counter);
+            return (counter.QuadPart/frequency.QuadPart)*1000000 + (counter.QuadPart%frequency.QuadPart)*1000000/frequency.QuadPart;
+#elif defined(__APPLE__)
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            return (long long)tv.tv_sec*1000000 + tv.tv_usec;
+#else
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#endif
+        }
+
+        const PointableData* pointableData(const FrameRef& frame, int index)
+        {
+            return frame.get() != NULL && index >= 0 ? &frame.get()->pointables[index] : NULL;
+        }
+
+        const HandData* handData(const FrameRef& frame, int index)
+        {
+            return frame.get() != NULL && index >= 0 ? &frame.get()->hands[index] : NULL;
+        }
+
+        const GestureData* gestureData(const FrameRef& frame, int index)
+        {
+            return frame.get() != NULL && index >= 0 ? &frame.get()->gestures[index] : NULL;
+        }
+
+        const std::vector<int>& noIndices()
+        {
+            static const std::vector<int> indices;
+            return indices;
+        }
+
+    }
+
+    //--------------------------------------------------------------------//
+    // Pointable, Finger
+    //--------------------------------------------------------------------//
+
+    int Pointable::id() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->id : -1; }
+    Frame Pointable::frame() const { return isValid() ? Frame(frame_) : Frame(); }
+    Hand Pointable::hand() const { const PointableData* d = pointableData(frame_, index_); return d != NULL && d->hand >= 0 ? Hand(frame_, d->hand) : Hand(); }
+    Vector Pointable::tipPosition() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->tip : Vector(); }
+    Vector Pointable::tipVelocity() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->tipVelocity : Vector(); }
+    Vector Pointable::stabilizedTipPosition() const { return tipPosition(); }
+    Vector Pointable::direction() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->direction : Vector(); }
+    float Pointable::width() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->width : 0.0f; }
+    float Pointable::length() const { const PointableData* d = pointableData(frame_, index_); return d != NULL ? d->length : 0.0f; }
+    bool Pointable::isFinger() const { const PointableData* d = pointableData(frame_, index_); return d != NULL && d->isFinger; }
+    bool Pointable::isTool() const { const PointableData* d = pointableData(frame_, index_); return d != NULL && !d->isFinger; }
+    bool Pointable::isExtended() const { return isExtendedPointable(frame_, index_); }
+
+    bool isExtendedPointable(const FrameRef& frame, int index)
+    {
+        const PointableData* d = pointableData(frame, index);
+        return d != NULL && d->extended;
+    }
+
+    Finger::Type Finger::type() const
+    {
+        const PointableData* d = pointableData(frame_, index_);
+        return d != NULL ? d->fingerType : TYPE_THUMB;
+    }
+
+    Bone Finger::bone(Bone::Type type) const
+    {
+        const PointableData* d = pointableData(frame_, index_);
+        if (d == NULL || !d->isFinger || type < Bone::TYPE_METACARPAL || type > Bone::TYPE_DISTAL) return Bone();
+        return Bone(d->bones[type].prevJoint, d->bones[type].nextJoint, d->width, type);
+    }
+
+    //--------------------------------------------------------------------//
+    // Hand, HandList
+    //--------------------------------------------------------------------//
+
+    int Hand::id() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->id : -1; }
+    Frame Hand::frame() const { return isValid() ? Frame(frame_) : Frame(); }
+    bool Hand::isLeft() const { const HandData* d = handData(frame_, index_); return d != NULL && d->left; }
+    float Hand::grabStrength() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->grabStrength : 0.0f; }
+    float Hand::palmWidth() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->palmWidth : 0.0f; }
+    Vector Hand::palmPosition() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->palm : Vector(); }
+    Vector Hand::stabilizedPalmPosition() const { return palmPosition(); }
+    Vector Hand::palmVelocity() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->palmVelocity : Vector(); }
+    Vector Hand::palmNormal() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->normal : Vector(); }
+    Vector Hand::direction() const { const HandData* d = handData(frame_, index_); return d != NULL ? d->direction : Vector(); }
+
+    float Hand::pinchStrength() const
+    {
+        // Thumb and index tips closer than 20 mm pinch fully, 80 mm not at all
+        const HandData* d = handData(frame_, index_);
+        if (d == NULL) return 0.0f;
+        const PointableData* thumb = NULL;
+        const PointableData* index = NULL;
+        for (std::vector<int>::const_iterator itr = d->fingers.begin(); itr != d->fingers.end(); ++itr) {
+            const PointableData* p = pointableData(frame_, *itr);
+            if (p->fingerType == Finger::TYPE_THUMB) thumb = p;
+            if (p->fingerType == Finger::TYPE_INDEX) index = p;
+        }
+        if (thumb == NULL || index == NULL) return 0.0f;
+        const float strength = (80.0f - thumb->tip.distanceTo(index->tip))/60.0f;
+        return std::max(0.0f, std::min(1.0f, strength));
+    }
+
+    PointableList Hand::pointables() const { const HandData* d = handData(frame_, index_); return PointableList(frame_, d != NULL ? d->pointables : noIndices()); }
+    FingerList Hand::fingers() const { const HandData* d = handData(frame_, index_); return FingerList(frame_, d != NULL ? d->fingers : noIndices()); }
+    ToolList Hand::tools() const { const HandData* d = handData(frame_, index_); return ToolList(frame_, d != NULL ? d->tools : noIndices()); }
+
+    Hand HandList::leftmost() const
+    {
+        Hand result;
+        for (int i = 0; i < count(); ++i) {
+            const Hand hand = (*this)[i];
+            if (!result.isValid() || hand.palmPosition().x < result.palmPosition().x) result = hand;
+        }
+        return result;
+    }
+
+    Hand HandList::rightmost() const
+    {
+        Hand result;
+        for (int i = 0; i < count(); ++i) {
+            const Hand hand = (*this)[i];
+            if (!result.isValid() || hand.palmPosition().x > result.palmPosition().x) result = hand;
+        }
+        return result;
+    }
+
+    //--------------------------------------------------------------------//
+    // Gesture, InteractionBox, Image
+    //--------------------------------------------------------------------//
+
+    int Gesture::id() const { const GestureData* d = gestureData(frame_, index_); return d != NULL ? d->id : -1; }
+    Gesture::Type Gesture::type() const { const GestureData* d = gestureData(frame_, index_); return d != NULL ? d->type : TYPE_INVALID; }
+    Gesture::State Gesture::state() const { const GestureData* d = gestureData(frame_, index_); return d != NULL ? d->state : STATE_INVALID; }
+    Frame Gesture::frame() const { return isValid() ? Frame(frame_) : Frame(); }
+    PointableList Gesture::pointables() const { const GestureData* d = gestureData(frame_, index_); return PointableList(frame_, d != NULL ? d->pointables : noIndices()); }
+
+    Vector InteractionBox::normalizePoint(const Vector& position, bool clamp) const
+    {
+        if (!valid_) return Vector();
+        Vector result((position.x - center_.x)/size_.x + 0.5f,
+            (position.y - center_.y)/size_.y + 0.5f,
+            (position.z - center_.z)/size_.z + 0.5f);
+        if (clamp) {
+            result.x = std::max(0.0f, std::min(1.0f, result.x));
+            result.y = std::max(0.0f, std::min(1.0f, result.y));
+            result.z = std::max(0.0f, std::min(1.0f, result.z));
+        }
+        return result;
+    }
+
+    Vector InteractionBox::denormalizePoint(const Vector& normalizedPosition) const
+    {
+        if (!valid_) return Vector();
+        return Vector((normalizedPosition.x - 0.5f)*size_.x + center_.x,
+            (normalizedPosition.y - 0.5f)*size_.y + center_.y,
+            (normalizedPosition.z - 0.5f)*size_.z + center_.z);
+    }
+
+    // The feeds carry no images, so there are no valid ones
+    int Image::id() const { return -1; }
+    long long Image::sequenceId() const { return -1; }
+    int Image::width() const { return 0; }
+    int Image::height() const { return 0; }
+    int Image::bytesPerPixel() const { return 0; }
+    const unsigned char* Image::data() const { return NULL; }
+
+    //--------------------------------------------------------------------//
+    // Feeds
+    //--------------------------------------------------------------------//
+
+    class Feed {
+    public:
+        virtual ~Feed() {}
+
+        // Content of the next frame, with timestamp set, or false if there
+        // is none (any more)
+        virtual bool next(FrameContent& frame) = 0;
+    };
+
+    // A right hand moving on a Lissajous figure, pointing with the index
+    // finger and tapping every two seconds
+    class ScriptedFeed: public Feed {
+    public:
+        explicit ScriptedFeed(double rate): interval_(1000000.0/rate), count_(0), nextGestureID_(1) {}
+
+        virtual bool next(FrameContent& frame)
+        {
+            const long long timestamp = (long long)(count_*interval_);
+            ++count_;
+            const float t = (float)timestamp*1e-6f;
+
+            frame = FrameContent();
+            frame.timestamp = timestamp;
+
+            HandData hand;
+            hand.id = 1;
+            hand.left = false;
+            hand.palm = Vector(80.0f*std::sin(2.0f*PI*0.13f*t), 200.0f + 60.0f*std::sin(2.0f*PI*0.21f*t), 40.0f);
+            hand.normal = Vector(0.0f, -1.0f, 0.0f);
+            hand.direction = Vector(0.0f, 0.0f, -1.0f);
+            frame.hands.push_back(hand);
+
+            // Forward stroke of the index finger, 120 ms out of 2 s
+            const float tapPhase = std::fmod(t, 2.0f)/0.12f;
+            const float stroke = tapPhase < 1.0f ? 25.0f*std::sin(PI*tapPhase) : 0.0f;
+
+            static const Vector knuckles[5] = {
+                Vector(-45.0f, -5.0f, -20.0f),
+                Vector(-22.0f, 0.0f, -45.0f),
+                Vector(0.0f, 0.0f, -50.0f),
+                Vector(20.0f, 0.0f, -45.0f),
+                Vector(38.0f, -2.0f, -35.0f)
+            };
+            static const float lengths[5] = { 50.0f, 55.0f, 62.0f, 58.0f, 45.0f };
+            for (int i = 0; i < 5; ++i) {
+                PointableData finger;
+                finger.id = 10 + i;
+                finger.handID = hand.id;
+                finger.fingerType = (Finger::Type)i;
+                finger.extended = (i == Finger::TYPE_INDEX);
+                finger.length = lengths[i];
+                finger.width = i == Finger::TYPE_PINKY ? 15.0f : 18.0f;
+                if (finger.extended) {
+                    finger.direction = Vector(0.0f, 0.0f, -1.0f);
+                    finger.tip = hand.palm + knuckles[i] + Vector(0.0f, 0.0f, -finger.length - stroke);
+                } else {
+                    // Curled towards the palm
+                    finger.direction = Vector(0.0f, -1.0f, 0.5f);
+                    finger.tip = hand.palm + knuckles[i] + Vector(0.0f, -25.0f, 15.0f);
+                }
+                frame.pointables.push_back(finger);
+            }
+
+            // One screen tap at the deepest point of the stroke
+            const float previousPhase = std::fmod(t - (float)(interval_*1e-6), 2.0f)/0.12f;
+            if (tapPhase >= 0.5f && tapPhase < 1.0f && previousPhase < 0.5f) {
+                GestureData gesture;
+                gesture.id = nextGestureID_++;
+                gesture.type = Gesture::TYPE_SCREEN_TAP;
+                gesture.pointableIDs.push_back(10 + Finger::TYPE_INDEX);
+                frame.gestures.push_back(gesture);
+            }
+            return true;
+        }
+
+    private:
+        double interval_;
+        long long count_;
+        int nextGestureID_;
+    };
+
+    // Replays a frame file, see Leap.h for the format
+    class FileFeed: public Feed {
+    public:
+        FileFeed(const std::string& filename, bool loop): loop_(loop), current_(0), offset_(0)
+        {
+            std::ifstream file(filename.c_str());
+            if (!file) {
+                std::cerr<<"LeapShim: Could not open "<<filename<<"."<<std::endl;
+                return;
+            }
+
+            std::string line;
+            unsigned int lineNumber = 0;
+            while (std::getline(file, line)) {
+                ++lineNumber;
+                std::istringstream in(line);
+                std::string item;
+                if (!(in>>item) || item[0] == '#') continue;
+
+                if (item == "frame") {
+                    frames_.push_back(FrameContent());
+                    if (!(in>>frames_.back().timestamp)) warn(filename, lineNumber, line);
+                    continue;
+                }
+                if (frames_.empty()) {
+                    warn(filename, lineNumber, line);
+                    continue;
+                }
+
+                FrameContent& frame = frames_.back();
+                bool ok = false;
+                if (item == "box") {
+                    ok = readVector(in, frame.boxCenter) && readVector(in, frame.boxSize);
+                } else if (item == "hand") {
+                    HandData hand;
+                    std::string side;
+                    ok = (in>>hand.id>>side) && (side == "left" || side == "right") &&
+                        readVector(in, hand.palm) && readVector(in, hand.normal) && readVector(in, hand.direction);
+                    hand.left = (side == "left");
+                    if (ok && !(in>>hand.grabStrength)) hand.grabStrength = 0.0f;
+                    if (ok) frame.hands.push_back(hand);
+                } else if (item == "finger") {
+                    PointableData finger;
+                    int type = 0;
+                    int extended = 1;
+                    ok = (in>>finger.id>>finger.handID>>type>>extended) && type >= 0 && type <= 4 &&
+                        readVector(in, finger.tip) && readVector(in, finger.direction);
+                    finger.fingerType = (Finger::Type)type;
+                    finger.extended = (extended != 0);
+                    if (ok && in>>finger.length) in>>finger.width;
+                    if (ok) frame.pointables.push_back(finger);
+                } else if (item == "tool") {
+                    PointableData tool;
+                    tool.isFinger = false;
+                    tool.length = 120.0f;
+                    tool.width = 5.0f;
+                    ok = (in>>tool.id) && readVector(in, tool.tip) && readVector(in, tool.direction);
+                    if (ok) in>>tool.length;
+                    if (ok) frame.pointables.push_back(tool);
+                } else if (item == "gesture") {
+                    GestureData gesture;
+                    std::string type;
+                    ok = !(in>>gesture.id>>type).fail();
+                    if (type == "circle") gesture.type = Gesture::TYPE_CIRCLE;
+                    else if (type == "swipe") gesture.type = Gesture::TYPE_SWIPE;
+                    else if (type == "key_tap") gesture.type = Gesture::TYPE_KEY_TAP;
+                    else if (type == "screen_tap") gesture.type = Gesture::TYPE_SCREEN_TAP;
+                    else ok = false;
+                    // Taps are discrete, the others are reported while going on
+                    gesture.state = (gesture.type == Gesture::TYPE_CIRCLE || gesture.type == Gesture::TYPE_SWIPE) ?
+                        Gesture::STATE_UPDATE : Gesture::STATE_STOP;
+                    int pointableID;
+                    while (in>>pointableID) gesture.pointableIDs.push_back(pointableID);
+                    if (ok) frame.gestures.push_back(gesture);
+                }
+                if (!ok) warn(filename, lineNumber, line);
+            }
+
+            if (frames_.empty()) {
+                std::cerr<<"LeapShim: No frames in "<<filename<<"."<<std::endl;
+            }
+        }
+
+        virtual bool next(FrameContent& frame)
+        {
+            if (frames_.empty()) return false;
+            if (current_ >= frames_.size()) {
+                if (!loop_) return false;
+                // Keep the timestamps increasing, one frame interval apart
+                const long long first = frames_.front().timestamp;
+                const long long last = frames_.back().timestamp;
+                const long long interval = frames_.size() > 1 ? (last - first)/(long long)(frames_.size() - 1) : 10000;
+                offset_ += last - first + std::max(interval, 1LL);
+                current_ = 0;
+            }
+            frame = frames_[current_++];
+            frame.timestamp += offset_;
+            return true;
+        }
+
+    private:
+        static bool readVector(std::istream& in, Vector& v)
+        {
+            return (in>>v.x>>v.y>>v.z) ? true : false;
+        }
+
+        static void warn(const std::string& filename, unsigned int lineNumber, const std::string& line)
+        {
+            std::cerr<<"LeapShim: Ignoring "<<filename<<":"<<lineNumber<<": "<<line<<std::endl;
+        }
+
+        std::vector<FrameContent> frames_;
+        bool loop_;
+        std::size_t current_;
+        long long offset_;
+    };
+
+    //--------------------------------------------------------------------//
+    // Service
+    //--------------------------------------------------------------------//
+
+    class ControllerImplementation {
+    public:
+        ControllerImplementation(): refCount(0), policyFlags(Controller::POLICY_DEFAULT), gestures(0) {}
+
+        OpenThreads::Atomic refCount;
+        volatile int policyFlags;
+        volatile unsigned int gestures;
+    };
+
+    // Produces the frames for all controllers of the process on a thread
+    // of its own and calls the listeners from there
+    class Service: public OpenThreads::Thread {
+    public:
+        enum { HISTORY_SIZE = 60 };
+
+        static Service* instance()
+        {
+            // Never deleted, listeners may be removed during static
+            // destruction; the thread is stopped by the Shutdown object
+            static Service* service = new Service();
+            static Shutdown shutdown(service);
+            return service;
+        }
+
+        // The feed starts with the first listener or frame request, so
+        // short files are not over before anyone listens
+        void startOnce()
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(startMutex_);
+            if (started_) return;
+            started_ = true;
+            start();
+        }
+
+        bool addListener(Listener* listener, ControllerImplementation* controller)
+        {
+            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(listenerMutex_);
+            if (findEntry(listener, controller) >= 0) return false;
+            Entry entry;
+            entry.listener = listener;
+            entry.controller = controller;
+            entry.state = Entry::ADDED;
+            entries_.push_back(entry);
+            return true;
+        }
+
+        bool removeListener(Listener* listener, ControllerImplementation* controller, bool notify)
+        {
+            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(listenerMutex_);
+            const int index = findEntry(listener, controller);
+            if (index < 0) return false;
+            const bool initialized = entries_[index].state != Entry::ADDED;
+            entries_.erase(entries_.begin() + index);
+            if (notify && initialized) listener->onExit(Controller(controller));
+            return true;
+        }
+
+        // Drops a reference to controller. Locked, so the thread does not
+        // hand out a controller going away to its listeners. The listeners
+        // are removed without notification, they may be gone already.
+        void releaseController(ControllerImplementation* controller)
+        {
+            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(listenerMutex_);
+            if (--controller->refCount != 0) return;
+            for (std::vector<Entry>::iterator itr = entries_.begin(); itr != entries_.end();) {
+                if (itr->controller == controller) itr = entries_.erase(itr);
+                else ++itr;
+            }
+            delete controller;
+        }
+
+        bool isConnected() const { return connected_; }
+
+        FrameRef frame(int history) const
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(historyMutex_);
+            if (history < 0 || history >= (int)history_.size()) return FrameRef();
+            return history_[history_.size() - 1 - history];
+        }
+
+        // Gestures of the frames in (since, until]
+        std::vector<Gesture> gestures(long long since, long long until) const
+        {
+            std::vector<Gesture> result;
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(historyMutex_);
+            for (std::vector<FrameRef>::const_iterator itr = history_.begin(); itr != history_.end(); ++itr) {
+                const FrameData* data = itr->get();
+                if (data->id <= since || data->id > until) continue;
+                for (unsigned int i = 0; i < data->gestures.size(); ++i) {
+                    result.push_back(Gesture(*itr, (int)i));
+                }
+            }
+            return result;
+        }
+
+        virtual int cancel()
+        {
+            done_ = true;
+            if (isRunning()) join();
+            return 0;
+        }
+
+        virtual void run()
+        {
+            long long startClock = 0;
+            long long startTimestamp = 0;
+            long long frameID = 0;
+            FrameRef previous;
+
+            while (!done_) {
+                FrameContent content;
+                if (!feed_->next(content)) {
+                    // End of a file played once, keep serving listeners
+                    initializeListeners();
+                    OpenThreads::Thread::microSleep(10000);
+                    continue;
+                }
+
+                // Pace by the timestamps of the feed
+                if (frameID == 0) {
+                    startClock = currentTime();
+                    startTimestamp = content.timestamp;
+                } else if (speed_ > 0.0) {
+                    const long long due = startClock + (long long)((double)(content.timestamp - startTimestamp)/speed_);
+                    for (long long now = currentTime(); now < due && !done_; now = currentTime()) {
+                        OpenThreads::Thread::microSleep((unsigned int)std::min(due - now, 10000LL));
+                    }
+                    if (done_) break;
+                }
+
+                content.id = ++frameID;
+                content.complete(previous.get());
+                const FrameRef frame(new FrameData(content));
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(historyMutex_);
+                    history_.push_back(frame);
+                    if (history_.size() > HISTORY_SIZE) history_.erase(history_.begin());
+                }
+                previous = frame;
+                connected_ = true;
+
+                initializeListeners();
+                dispatchFrame();
+            }
+        }
+
+    protected:
+        struct Entry {
+            enum State { ADDED, INITIALIZED, CONNECTED };
+
+            Listener* listener;
+            ControllerImplementation* controller;
+            State state;
+        };
+
+        class Shutdown {
+        public:
+            explicit Shutdown(Service* service): service_(service) {}
+            ~Shutdown() { service_->cancel(); }
+
+        private:
+            Service* service_;
+        };
+
+        Service(): OpenThreads::Thread(), started_(false), done_(false), connected_(false), speed_(1.0)
+        {
+            const char* speed = getenv("OSGLEAP_SHIM_SPEED");
+            if (speed != NULL) speed_ = std::max(0.0, atof(speed));
+
+            const char* filename = getenv("OSGLEAP_SHIM_FEED");
+            if (filename != NULL && *filename != '\0') {
+                const char* loop = getenv("OSGLEAP_SHIM_LOOP");
+                feed_ = new FileFeed(filename, loop == NULL || atoi(loop) != 0);
+            } else {
+                const char* rate = getenv("OSGLEAP_SHIM_RATE");
+                const double frameRate = rate != NULL ? atof(rate) : 0.0;
+                feed_ = new ScriptedFeed(frameRate > 0.0 ? frameRate : 110.0);
+            }
+        }
+
+        int findEntry(Listener* listener, ControllerImplementation* controller) const
+        {
+            for (unsigned int i = 0; i < entries_.size(); ++i) {
+                if (entries_[i].listener == listener && entries_[i].controller == controller) return (int)i;
+            }
+            return -1;
+        }
+
+        // Listeners may add or remove listeners from within their callbacks,
+        // so each entry is looked up again before it is called
+        void initializeListeners()
+        {
+            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(listenerMutex_);
+            const std::vector<Entry> entries = entries_;
+            for (std::vector<Entry>::const_iterator itr = entries.begin(); itr != entries.end(); ++itr) {
+                int index = findEntry(itr->listener, itr->controller);
+                if (index >= 0 && entries_[index].state == Entry::ADDED) {
+                    entries_[index].state = Entry::INITIALIZED;
+                    itr->listener->onInit(Controller(itr->controller));
+                }
+                index = findEntry(itr->listener, itr->controller);
+                if (index >= 0 && entries_[index].state == Entry::INITIALIZED && connected_) {
+                    entries_[index].state = Entry::CONNECTED;
+                    itr->listener->onConnect(Controller(itr->controller));
+                }
+            }
+        }
+
+        void dispatchFrame()
+        {
+            OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(listenerMutex_);
+            const std::vector<Entry> entries = entries_;
+            for (std::vector<Entry>::const_iterator itr = entries.begin(); itr != entries.end(); ++itr) {
+                const int index = findEntry(itr->listener, itr->controller);
+                if (index < 0 || entries_[index].state != Entry::CONNECTED) continue;
+                itr->listener->onFrame(Controller(itr->controller));
+            }
+        }
+
+        OpenThreads::Mutex startMutex_;
+        bool started_;
+        volatile bool done_;
+        volatile bool connected_;
+        double speed_;
+        Feed* feed_;
+
+        mutable OpenThreads::Mutex historyMutex_;
+        std::vector<FrameRef> history_;
+
+        OpenThreads::ReentrantMutex listenerMutex_;
+        std::vector<Entry> entries_;
+    };
+
+    //--------------------------------------------------------------------//
+    // Frame
+    //--------------------------------------------------------------------//
+
+    long long Frame::id() const { return isValid() ? frame_.get()->id : -1; }
+    long long Frame::timestamp() const { return isValid() ? frame_.get()->timestamp : 0; }
+    float Frame::currentFramesPerSecond() const { return isValid() ? frame_.get()->fps : 0.0f; }
+    HandList Frame::hands() const { return HandList(frame_, isValid() ? frame_.get()->handIndices : noIndices()); }
+    PointableList Frame::pointables() const { return PointableList(frame_, isValid() ? frame_.get()->pointableIndices : noIndices()); }
+    FingerList Frame::fingers() const { return FingerList(frame_, isValid() ? frame_.get()->fingerIndices : noIndices()); }
+    ToolList Frame::tools() const { return ToolList(frame_, isValid() ? frame_.get()->toolIndices : noIndices()); }
+    ImageList Frame::images() const { return ImageList(); }
+
+    Hand Frame::hand(int id) const
+    {
+        const int index = isValid() ? frame_.get()->findHand(id) : -1;
+        return index >= 0 ? Hand(frame_, index) : Hand();
+    }
+
+    Pointable Frame::pointable(int id) const
+    {
+        const int index = isValid() ? frame_.get()->findPointable(id) : -1;
+        return index >= 0 ? Pointable(frame_, index) : Pointable();
+    }
+
+    InteractionBox Frame::interactionBox() const
+    {
+        return isValid() ? InteractionBox(frame_.get()->boxCenter, frame_.get()->boxSize) : InteractionBox();
+    }
+
+    GestureList Frame::gestures() const
+    {
+        std::vector<Gesture> gestures;
+        if (isValid()) {
+            for (unsigned int i = 0; i < frame_.get()->gestures.size(); ++i) gestures.push_back(Gesture(frame_, (int)i));
+        }
+        return GestureList(gestures);
+    }
+
+    GestureList Frame::gestures(const Frame& sinceFrame) const
+    {
+        if (!isValid()) return GestureList();
+        if (!sinceFrame.isValid() || sinceFrame.id() >= id()) return gestures();
+        return GestureList(Service::instance()->gestures(sinceFrame.id(), id()));
+    }
+
+    //--------------------------------------------------------------------//
+    // Controller
+    //--------------------------------------------------------------------//
+
+    Controller::Controller(): implementation_(new ControllerImplementation())
+    {
+        ++implementation_->refCount;
+    }
+
+    Controller::Controller(Listener& listener): implementation_(new ControllerImplementation())
+    {
+        ++implementation_->refCount;
+        addListener(listener);
+    }
+
+    Controller::Controller(ControllerImplementation* implementation): implementation_(implementation)
+    {
+        ++implementation_->refCount;
+    }
+
+    Controller::Controller(const Controller& other): implementation_(other.implementation_)
+    {
+        ++implementation_->refCount;
+    }
+
+    Controller& Controller::operator=(const Controller& other)
+    {
+        if (implementation_ == other.implementation_) return *this;
+        ControllerImplementation* previous = implementation_;
+        implementation_ = other.implementation_;
+        ++implementation_->refCount;
+        Service::instance()->releaseController(previous);
+        return *this;
+    }
+
+    Controller::~Controller()
+    {
+        Service::instance()->releaseController(implementation_);
+    }
+
+    bool Controller::isConnected() const { return Service::instance()->isConnected(); }
+    Controller::PolicyFlag Controller::policyFlags() const { return (PolicyFlag)implementation_->policyFlags; }
+    void Controller::setPolicyFlags(PolicyFlag flags) const { implementation_->policyFlags = flags; }
+
+    bool Controller::addListener(Listener& listener)
+    {
+        const bool added = Service::instance()->addListener(&listener, implementation_);
+        Service::instance()->startOnce();
+        return added;
+    }
+
+    bool Controller::removeListener(Listener& listener)
+    {
+        return Service::instance()->removeListener(&listener, implementation_, true);
+    }
+
+    Frame Controller::frame(int history) const
+    {
+        Service::instance()->startOnce();
+        return Frame(Service::instance()->frame(history));
+    }
+
+    void Controller::enableGesture(Gesture::Type type, bool enable) const
+    {
+        if (type < 0) return;
+        if (enable) implementation_->gestures |= (1u << type);
+        else implementation_->gestures &= ~(1u << type);
+    }
+
+    bool Controller::isGestureEnabled(Gesture::Type type) const
+    {
+        return type >= 0 && (implementation_->gestures & (1u << type)) != 0;
+    }
+
+} /* namespace Leap */
@@ -0,0 +1,473 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Stand-in for Leap.h of the LeapSDK 2.x, built with the CMake option
+// OSGLEAP_USE_LEAPSDK_SHIM. Implements the part of the SDK osgLeap uses, so
+// the library and the examples build, run and can be profiled on machines
+// without the proprietary SDK or a device.
+//
+// All controllers share one stand-in service, which produces frames on a
+// thread of its own and calls the listeners' onFrame from there, like the
+// real SDK does. It starts with the first addListener or frame() call.
+// Frames come from a feed selected by environment variables:
+//
+//   OSGLEAP_SHIM_FEED   Frame file to replay (see below). Without it, a
+//                       scripted right hand moves around with the index
+//                       finger extended and taps every two seconds.
+//   OSGLEAP_SHIM_SPEED  Replay speed, 1 is real time (default), 0 replays
+//                       as fast as possible.
+//   OSGLEAP_SHIM_LOOP   0 stops after the last frame of the file, it is
+//                       replayed in a loop otherwise.
+//   OSGLEAP_SHIM_RATE   Frames per second of the scripted hand (default 110)
+//
+// Frame files are plain text, one item per line, millimeters and
+// microseconds; lines starting with # are comments:
+//
+//   frame <timestamp>
+//   box <centerX> <centerY> <centerZ> <width> <height> <depth>
+//   hand <id> <left|right> <palmX> <palmY> <palmZ> <normalX> <normalY> <normalZ> <dirX> <dirY> <dirZ> [grabStrength]
+//   finger <id> <handID> <type 0..4> <extended 0|1> <tipX> <tipY> <tipZ> <dirX> <dirY> <dirZ> [length] [width]
+//   tool <id> <tipX> <tipY> <tipZ> <dirX> <dirY> <dirZ> [length]
+//   gesture <id> <circle|swipe|key_tap|screen_tap> <pointableID> ...
+//
+// Every frame starts with a frame line. Velocities are computed from the
+// previous frame, bones are spread along the fingers and stabilized
+// positions equal the raw ones. The feed does not carry sensor images;
+// gestures and images are delivered regardless of enableGesture and the
+// policy flags.
+
+#ifndef OSGLEAP_LEAPSHIM_LEAP_H_
+#define OSGLEAP_LEAPSHIM_LEAP_H_ 1
+
+//-- Leap --//
+#include "LeapMath.h"
+
+//-- STL --//
+#include <vector>
+
+namespace Leap {
+
+    struct FrameData;
+    class ControllerImplementation;
+    class Service;
+
+    class Frame;
+    class Hand;
+    class Pointable;
+    class Controller;
+
+    // Shared, immutable data of a frame (shim internal)
+    class LEAP_EXPORT FrameRef {
+    public:
+        FrameRef(): data_(0) {}
+        explicit FrameRef(FrameData* data);
+        FrameRef(const FrameRef& other);
+        ~FrameRef();
+        FrameRef& operator=(const FrameRef& other);
+
+        const FrameData* get() const { return data_; }
+
+    private:
+        FrameData* data_;
+    };
+
+    template<class L, class T>
+    class ConstListIterator {
+    public:
+        ConstListIterator(): list_(0), index_(0) {}
+        ConstListIterator(const L& list, int index): list_(&list), index_(index) {}
+
+        T operator*() const { return (*list_)[index_]; }
+        ConstListIterator& operator++() { ++index_; return *this; }
+        ConstListIterator operator++(int) { ConstListIterator tmp(*this); ++index_; return tmp; }
+        bool operator==(const ConstListIterator& other) const { return index_ == other.index_; }
+        bool operator!=(const ConstListIterator& other) const { return index_ != other.index_; }
+
+    private:
+        const L* list_;
+        int index_;
+    };
+
+    // Whether the pointable at index of the frame is extended
+    LEAP_EXPORT bool isExtendedPointable(const FrameRef& frame, int index);
+
+    // Lists refer to the index vectors of the frame data they keep alive,
+    // so neither they nor their extended() views allocate
+    template<class T>
+    class FrameItemList {
+    public:
+        typedef ConstListIterator<FrameItemList, T> const_iterator;
+
+        FrameItemList(): indices_(0), extendedOnly_(false) {}
+        FrameItemList(const FrameRef& frame, const std::vector<int>& indices, bool extendedOnly = false):
+            frame_(frame), indices_(&indices), extendedOnly_(extendedOnly) {}
+
+        int count() const
+        {
+            if (indices_ == 0) return 0;
+            if (!extendedOnly_) return (int)indices_->size();
+            int result = 0;
+            for (unsigned int i = 0; i < indices_->size(); ++i) {
+                if (isExtendedPointable(frame_, (*indices_)[i])) ++result;
+            }
+            return result;
+        }
+
+        bool isEmpty() const { return count() == 0; }
+        T operator[](int index) const { return T(frame_, item(index)); }
+
+        const_iterator begin() const { return const_iterator(*this, 0); }
+        const_iterator end() const { return const_iterator(*this, count()); }
+
+        // Pointable lists only
+        FrameItemList extended() const
+        {
+            return indices_ != 0 ? FrameItemList(frame_, *indices_, true) : FrameItemList();
+        }
+
+    protected:
+        FrameRef frame_;
+        const std::vector<int>* indices_;
+        bool extendedOnly_;
+
+        // Frame index of the index-th item of the list
+        int item(int index) const
+        {
+            if (!extendedOnly_) return (*indices_)[index];
+            for (unsigned int i = 0; i < indices_->size(); ++i) {
+                const int candidate = (*indices_)[i];
+                if (isExtendedPointable(frame_, candidate) && index-- == 0) return candidate;
+            }
+            return -1;
+        }
+    };
+
+    class LEAP_EXPORT Bone {
+    public:
+        enum Type {
+            TYPE_METACARPAL = 0,
+            TYPE_PROXIMAL = 1,
+            TYPE_INTERMEDIATE = 2,
+            TYPE_DISTAL = 3
+        };
+
+        Bone(): type_(TYPE_METACARPAL), width_(0.0f), valid_(false) {}
+        Bone(const Vector& prevJoint, const Vector& nextJoint, float width, Type type): prevJoint_(prevJoint),
+            nextJoint_(nextJoint), type_(type), width_(width), valid_(true) {}
+
+        Vector prevJoint() const { return prevJoint_; }
+        Vector nextJoint() const { return nextJoint_; }
+        Vector center() const { return (prevJoint_ + nextJoint_)*0.5f; }
+        Vector direction() const { return (nextJoint_ - prevJoint_).normalized(); }
+        float length() const { return (nextJoint_ - prevJoint_).magnitude(); }
+        float width() const { return width_; }
+        Type type() const { return type_; }
+        bool isValid() const { return valid_; }
+
+    private:
+        Vector prevJoint_;
+        Vector nextJoint_;
+        Type type_;
+        float width_;
+        bool valid_;
+    };
+
+    class LEAP_EXPORT Pointable {
+    public:
+        Pointable(): index_(-1) {}
+        Pointable(const FrameRef& frame, int index): frame_(frame), index_(index) {}
+
+        int id() const;
+        Frame frame() const;
+        Hand hand() const;
+        Vector tipPosition() const;
+        Vector tipVelocity() const;
+        Vector stabilizedTipPosition() const;
+        Vector direction() const;
+        float width() const;
+        float length() const;
+        bool isFinger() const;
+        bool isTool() const;
+        bool isExtended() const;
+        bool isValid() const { return index_ >= 0 && frame_.get() != 0; }
+
+        bool operator==(const Pointable& other) const { return frame_.get() == other.frame_.get() && index_ == other.index_; }
+        bool operator!=(const Pointable& other) const { return !(*this == other); }
+
+    protected:
+        friend class Finger;
+        friend class Tool;
+
+        FrameRef frame_;
+        int index_;
+    };
+
+    class LEAP_EXPORT Finger: public Pointable {
+    public:
+        enum Type {
+            TYPE_THUMB = 0,
+            TYPE_INDEX = 1,
+            TYPE_MIDDLE = 2,
+            TYPE_RING = 3,
+            TYPE_PINKY = 4
+        };
+
+        Finger() {}
+        Finger(const FrameRef& frame, int index): Pointable(frame, index) {}
+        explicit Finger(const Pointable& pointable): Pointable(pointable.isFinger() ? pointable : Pointable()) {}
+
+        Type type() const;
+        Bone bone(Bone::Type type) const;
+    };
+
+    class Tool: public Pointable {
+    public:
+        Tool() {}
+        Tool(const FrameRef& frame, int index): Pointable(frame, index) {}
+        explicit Tool(const Pointable& pointable): Pointable(pointable.isTool() ? pointable : Pointable()) {}
+    };
+
+    typedef FrameItemList<Pointable> PointableList;
+    typedef FrameItemList<Finger> FingerList;
+    typedef FrameItemList<Tool> ToolList;
+
+    class LEAP_EXPORT Hand {
+    public:
+        Hand(): index_(-1) {}
+        Hand(const FrameRef& frame, int index): frame_(frame), index_(index) {}
+
+        int id() const;
+        Frame frame() const;
+        bool isValid() const { return index_ >= 0 && frame_.get() != 0; }
+        bool isLeft() const;
+        bool isRight() const { return isValid() && !isLeft(); }
+        float grabStrength() const;
+        float pinchStrength() const;
+        float palmWidth() const;
+        Vector palmPosition() const;
+        Vector stabilizedPalmPosition() const;
+        Vector palmVelocity() const;
+        Vector palmNormal() const;
+        Vector direction() const;
+        PointableList pointables() const;
+        FingerList fingers() const;
+        ToolList tools() const;
+
+        bool operator==(const Hand& other) const { return frame_.get() == other.frame_.get() && index_ == other.index_; }
+        bool operator!=(const Hand& other) const { return !(*this == other); }
+
+    private:
+        FrameRef frame_;
+        int index_;
+    };
+
+    class LEAP_EXPORT HandList: public FrameItemList<Hand> {
+    public:
+        typedef ConstListIterator<HandList, Hand> const_iterator;
+
+        HandList() {}
+        HandList(const FrameRef& frame, const std::vector<int>& indices): FrameItemList<Hand>(frame, indices) {}
+
+        const_iterator begin() const { return const_iterator(*this, 0); }
+        const_iterator end() const { return const_iterator(*this, count()); }
+
+        // Smallest and largest palm x, invalid for an empty list
+        Hand leftmost() const;
+        Hand rightmost() const;
+    };
+
+    class LEAP_EXPORT Gesture {
+    public:
+        enum Type {
+            TYPE_INVALID = -1,
+            TYPE_SWIPE = 1,
+            TYPE_CIRCLE = 4,
+            TYPE_SCREEN_TAP = 5,
+            TYPE_KEY_TAP = 6
+        };
+
+        enum State {
+            STATE_INVALID = -1,
+            STATE_START = 1,
+            STATE_UPDATE = 2,
+            STATE_STOP = 3
+        };
+
+        Gesture(): index_(-1) {}
+        Gesture(const FrameRef& frame, int index): frame_(frame), index_(index) {}
+
+        int id() const;
+        Type type() const;
+        State state() const;
+        Frame frame() const;
+        PointableList pointables() const;
+        bool isValid() const { return index_ >= 0 && frame_.get() != 0; }
+
+    private:
+        FrameRef frame_;
+        int index_;
+    };
+
+    class LEAP_EXPORT GestureList {
+    public:
+        typedef ConstListIterator<GestureList, Gesture> const_iterator;
+
+        GestureList() {}
+        explicit GestureList(const std::vector<Gesture>& gestures): gestures_(gestures) {}
+
+        int count() const { return (int)gestures_.size(); }
+        bool isEmpty() const { return gestures_.empty(); }
+        Gesture operator[](int index) const { return gestures_[index]; }
+
+        const_iterator begin() const { return const_iterator(*this, 0); }
+        const_iterator end() const { return const_iterator(*this, count()); }
+
+    private:
+        std::vector<Gesture> gestures_;
+    };
+
+    class LEAP_EXPORT InteractionBox {
+    public:
+        InteractionBox(): valid_(false) {}
+        InteractionBox(const Vector& center, const Vector& size): center_(center), size_(size), valid_(true) {}
+
+        Vector center() const { return center_; }
+        float width() const { return size_.x; }
+        float height() const { return size_.y; }
+        float depth() const { return size_.z; }
+        bool isValid() const { return valid_; }
+
+        // Maps the box to [0..1] on each axis
+        Vector normalizePoint(const Vector& position, bool clamp = true) const;
+        Vector denormalizePoint(const Vector& normalizedPosition) const;
+
+    private:
+        Vector center_;
+        Vector size_;
+        bool valid_;
+    };
+
+    class LEAP_EXPORT Image {
+    public:
+        Image(): index_(-1) {}
+        Image(const FrameRef& frame, int index): frame_(frame), index_(index) {}
+
+        int id() const;
+        long long sequenceId() const;
+        int width() const;
+        int height() const;
+        int bytesPerPixel() const;
+        const unsigned char* data() const;
+        bool isValid() const { return index_ >= 0 && frame_.get() != 0; }
+
+    private:
+        FrameRef frame_;
+        int index_;
+    };
+
+    typedef FrameItemList<Image> ImageList;
+
+    class LEAP_EXPORT Frame {
+    public:
+        Frame() {}
+        explicit Frame(const FrameRef& frame): frame_(frame) {}
+
+        long long id() const;
+        long long timestamp() const;
+        float currentFramesPerSecond() const;
+        bool isValid() const { return frame_.get() != 0; }
+
+        HandList hands() const;
+        Hand hand(int id) const;
+        PointableList pointables() const;
+        Pointable pointable(int id) const;
+        FingerList fingers() const;
+        ToolList tools() const;
+        InteractionBox interactionBox() const;
+        ImageList images() const;
+
+        // Gestures of this frame
+        GestureList gestures() const;
+        // Gestures of all frames after sinceFrame up to this one, as long
+        // as they are in the service's history
+        GestureList gestures(const Frame& sinceFrame) const;
+
+        bool operator==(const Frame& other) const { return frame_.get() == other.frame_.get(); }
+        bool operator!=(const Frame& other) const { return !(*this == other); }
+
+        static const Frame& invalid() { static const Frame frame; return frame; }
+
+    private:
+        FrameRef frame_;
+    };
+
+    class Listener {
+    public:
+        Listener() {}
+        virtual ~Listener() {}
+
+        virtual void onInit(const Controller&) {}
+        virtual void onConnect(const Controller&) {}
+        virtual void onDisconnect(const Controller&) {}
+        virtual void onExit(const Controller&) {}
+        virtual void onFrame(const Controller&) {}
+        virtual void onFocusGained(const Controller&) {}
+        virtual void onFocusLost(const Controller&) {}
+        virtual void onServiceConnect(const Controller&) {}
+        virtual void onServiceDisconnect(const Controller&) {}
+        virtual void onDeviceChange(const Controller&) {}
+        virtual void onImages(const Controller&) {}
+    };
+
+    class LEAP_EXPORT Controller {
+    public:
+        enum PolicyFlag {
+            POLICY_DEFAULT = 0,
+            POLICY_BACKGROUND_FRAMES = 1,
+            POLICY_IMAGES = 2,
+            POLICY_OPTIMIZE_HMD = 4
+        };
+
+        Controller();
+        explicit Controller(Listener& listener);
+        Controller(const Controller& other);
+        Controller& operator=(const Controller& other);
+        virtual ~Controller();
+
+        bool isConnected() const;
+        bool isServiceConnected() const { return true; }
+        bool hasFocus() const { return true; }
+
+        PolicyFlag policyFlags() const;
+        void setPolicyFlags(PolicyFlag flags) const;
+        void setPolicy(PolicyFlag policy) const { setPolicyFlags((PolicyFlag)(policyFlags() | policy)); }
+        void clearPolicy(PolicyFlag policy) const { setPolicyFlags((PolicyFlag)(policyFlags() & ~policy)); }
+        bool isPolicySet(PolicyFlag policy) const { return (policyFlags() & policy) != 0; }
+
+        bool addListener(Listener& listener);
+        bool removeListener(Listener& listener);
+
+        // history 0 is the newest frame, up to 59 frames back
+        Frame frame(int history = 0) const;
+
+        void enableGesture(Gesture::Type type, bool enable = true) const;
+        bool isGestureEnabled(Gesture::Type type) const;
+
+    private:
+        friend class Service;
+
+        explicit Controller(ControllerImplementation* implementation);
+
+        ControllerImplementation* implementation_;
+    };
+
+} /* namespace Leap */
+
+#endif /* OSGLEAP_LEAPSHIM_LEAP_H_ */
@@ -0,0 +1,96 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Stand-in for LeapMath.h of the LeapSDK, see Leap.h of the shim
+
+#ifndef OSGLEAP_LEAPSHIM_LEAPMATH_H_
+#define OSGLEAP_LEAPSHIM_LEAPMATH_H_ 1
+
+#if defined(_MSC_VER) || defined(__CYGWIN__) || defined(__MINGW32__)
+#  if defined( LEAPSHIM_LIBRARY )
+#    define LEAP_EXPORT   __declspec(dllexport)
+#  else
+#    define LEAP_EXPORT   __declspec(dllimport)
+#  endif
+#else
+#  define LEAP_EXPORT
+#endif
+
+//-- STL --//
+#include <cmath>
+
+namespace Leap {
+
+    static const float PI = 3.1415926536f;
+    static const float DEG_TO_RAD = 0.0174532925f;
+    static const float RAD_TO_DEG = 57.295779513f;
+
+    struct Vector {
+        Vector(): x(0.0f), y(0.0f), z(0.0f) {}
+        Vector(float _x, float _y, float _z): x(_x), y(_y), z(_z) {}
+
+        static const Vector& zero() { static const Vector v(0.0f, 0.0f, 0.0f); return v; }
+
+        float magnitude() const { return std::sqrt(x*x + y*y + z*z); }
+        float magnitudeSquared() const { return x*x + y*y + z*z; }
+        float distanceTo(const Vector& other) const { return (*this - other).magnitude(); }
+
+        float dot(const Vector& other) const { return x*other.x + y*other.y + z*other.z; }
+        Vector cross(const Vector& other) const
+        {
+            return Vector(y*other.z - z*other.y, z*other.x - x*other.z, x*other.y - y*other.x);
+        }
+
+        Vector normalized() const
+        {
+            const float m = magnitude();
+            if (m <= 0.0f) return Vector();
+            return *this/m;
+        }
+
+        float angleTo(const Vector& other) const
+        {
+            const float denom = magnitudeSquared()*other.magnitudeSquared();
+            if (denom <= 0.0f) return 0.0f;
+            float c = dot(other)/std::sqrt(denom);
+            if (c > 1.0f) c = 1.0f;
+            if (c < -1.0f) c = -1.0f;
+            return std::acos(c);
+        }
+
+        // Angles as defined by the LeapSDK, the device looks along -z
+        float pitch() const { return std::atan2(y, -z); }
+        float yaw() const { return std::atan2(x, -z); }
+        float roll() const { return std::atan2(x, -y); }
+
+        Vector operator-() const { return Vector(-x, -y, -z); }
+        Vector operator+(const Vector& other) const { return Vector(x + other.x, y + other.y, z + other.z); }
+        Vector operator-(const Vector& other) const { return Vector(x - other.x, y - other.y, z - other.z); }
+        Vector operator*(float scalar) const { return Vector(x*scalar, y*scalar, z*scalar); }
+        Vector operator/(float scalar) const { return Vector(x/scalar, y/scalar, z/scalar); }
+        Vector& operator+=(const Vector& other) { x += other.x; y += other.y; z += other.z; return *this; }
+        Vector& operator-=(const Vector& other) { x -= other.x; y -= other.y; z -= other.z; return *this; }
+        Vector& operator*=(float scalar) { x *= scalar; y *= scalar; z *= scalar; return *this; }
+        Vector& operator/=(float scalar) { x /= scalar; y /= scalar; z /= scalar; return *this; }
+        bool operator==(const Vector& other) const { return x == other.x && y == other.y && z == other.z; }
+        bool operator!=(const Vector& other) const { return !(*this == other); }
+
+        float operator[](unsigned int index) const { return index == 0 ? x : (index == 1 ? y : z); }
+
+        float x;
+        float y;
+        float z;
+    };
+
+    inline Vector operator*(float scalar, const Vector& v) { return v*scalar; }
+
+} /* namespace Leap */
+
+#endif /* OSGLEAP_LEAPSHIM_LEAPMATH_H_ */
@@ -12,22 +12,74 @@
 
 //-- Project --//
 #include <osgLeap/Event>
+#include <osgLeap/FlightRecorder>
+#include <osgLeap/TraceRecorder>
 
 namespace osgLeap {
 
+    // Upper limit of pooled events. Usually, one or two are in flight.
+    static const unsigned int EVENT_POOL_SIZE = 4;
+
+    // Frames the Leap service keeps in its own history
+    static const int SERVICE_HISTORY_SIZE = 60;
+
+    Event* Device::acquireEvent()
+    {
+        for (std::vector<osg::ref_ptr<Event> >::iterator itr = eventPool_.begin(); itr != eventPool_.end(); ++itr) {
+            // Only referenced by the pool: the queue is done with it
+            if ((*itr)->referenceCount() == 1) {
+                (*itr)->setHandled(false);
+                return itr->get();
+            }
+        }
+
+        Event* e = new Event();
+        if (eventPool_.size() < EVENT_POOL_SIZE) {
+            eventPool_.push_back(e);
+        }
+        return e;
+    }
+
     bool Device::checkEvents()
     {
         OSG_DEBUG_FP<<"PointerEventDevice::checkEvents"<<std::endl;
+        OSGLEAP_TRACE_SPAN(span, "Device::checkEvents");
+		frame_ = frames_.fetch();
 		if (frame_.id() != lastFrame_.id()) {
-			// Create new 'USER' event of class osgLeap::Event and push it to the queue
-			osg::ref_ptr<Event> e = new Event();
+            span.setFrameID(frame_.id());
+            span.setCounter(0, "events", 1);
+			// Get a 'USER' event of class osgLeap::Event and push it to the queue
+			updateFrameHistory();
+			osg::ref_ptr<Event> e = acquireEvent();
 			e->setFrame(frame_);
+			e->setFrameHistory(history_.get());
 			_eventQueue->addEvent(e);
 			lastFrame_ = frame_;
 		}
         return _eventQueue.valid() ? !(getEventQueue()->empty()) : false;
     }
 
+    void Device::updateFrameHistory()
+    {
+        const FrameHistory::FrameRecord* newest = history_->byAge(0);
+        const long long lastID = (newest != NULL) ? newest->id : -1;
+
+        // Collect the frames the service produced since the last event,
+        // newest first, up to frame_
+        missedFrames_.clear();
+        for (int h = 0; h < SERVICE_HISTORY_SIZE && missedFrames_.size() < history_->capacity(); ++h) {
+            Leap::Frame f = controller_.frame(h);
+            if (!f.isValid() || f.id() <= lastID) break;
+            if (f.id() <= frame_.id()) missedFrames_.push_back(f);
+        }
+        if (missedFrames_.empty()) missedFrames_.push_back(frame_);
+
+        for (std::vector<Leap::Frame>::reverse_iterator itr = missedFrames_.rbegin(); itr != missedFrames_.rend(); ++itr) {
+            history_->push(*itr);
+        }
+        missedFrames_.clear();
+    }
+
     void Device::sendEvent(const osgGA::GUIEventAdapter& ea)
     {
         OSG_DEBUG_FP<<"PointerEventDevice::sendEvent"<<std::endl;
@@ -35,7 +87,11 @@ namespace osgLeap {
 
 	void Device::onFrame(const Leap::Controller& controller)
 	{
-		frame_ = controller.frame();
+        OSGLEAP_TRACE_SPAN(span, "Device::onFrame");
+		const Leap::Frame frame = controller.frame();
+        span.setFrameID(frame.id());
+        FlightRecorder::instance()->recordFrame(frame);
+		frames_.post(frame);
 	}
 
 } // namespace osgLeap
@@ -0,0 +1,59 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/DwellEngine>
+
+namespace osgLeap {
+
+    DwellEngine::DwellEngine(): osg::Referenced(),
+        dwellTime_(0),
+        radius_(20.0f),
+        hysteresis_(5.0f)
+    {
+
+    }
+
+    bool DwellEngine::advance(State& state, const osg::Vec2& pos, long long timestamp) const
+    {
+        if (dwellTime_ <= 0) {
+            state.progress = 0.0f;
+            return false;
+        }
+        if (state.started && timestamp <= state.timestamp) return false;
+
+        const float distance = (pos - state.anchor).length();
+        const float limit = state.dwelling ? radius_ + hysteresis_ : radius_;
+        if (!state.started || distance > limit) {
+            // Moving: the next dwell may start here
+            state.started = true;
+            state.dwelling = false;
+            state.anchor = pos;
+            state.startTime = timestamp;
+        } else {
+            state.dwelling = true;
+        }
+        state.timestamp = timestamp;
+
+        const long long elapsed = timestamp - state.startTime;
+        const long long dwellTime = (long long)dwellTime_*1000;
+        if (elapsed >= dwellTime) {
+            state.progress = 1.0f;
+            state.clicked = true;
+            // Start over for the next click
+            state.dwelling = false;
+            state.anchor = pos;
+            state.startTime = timestamp;
+            return true;
+        }
+        state.progress = (float)elapsed/(float)dwellTime;
+        return false;
+    }
+
+} /* namespace osgLeap */
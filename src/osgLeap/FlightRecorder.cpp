@@ -0,0 +1,292 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/FlightRecorder>
+
+//-- OSG: osg --//
+#include <osg/Notify>
+
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+//-- STL --//
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+
+namespace osgLeap {
+
+    // Set by the signal handler, polled by recordFrame
+    static volatile sig_atomic_t sDumpRequested = 0;
+
+    static void dumpSignalHandler(int)
+    {
+        sDumpRequested = 1;
+    }
+
+    // Writes the ring without blocking the thread that requested the dump
+    class FlightRecorderDumpThread: public osg::Referenced, public OpenThreads::Thread {
+    public:
+        FlightRecorderDumpThread(FlightRecorder* recorder, const std::string& filename): osg::Referenced(), OpenThreads::Thread(),
+            recorder_(recorder),
+            filename_(filename)
+        {
+
+        }
+
+        virtual void run()
+        {
+            recorder_->dump(filename_);
+        }
+
+    protected:
+        virtual ~FlightRecorderDumpThread()
+        {
+            if (isRunning()) join();
+        }
+
+        FlightRecorder* recorder_;
+        std::string filename_;
+    };
+
+    // Orders copied records from oldest to newest
+    struct SequenceLess {
+        bool operator()(const std::pair<unsigned int, FlightRecorder::Record>& a,
+            const std::pair<unsigned int, FlightRecorder::Record>& b) const
+        {
+            return a.first < b.first;
+        }
+    };
+
+    FlightRecorder* FlightRecorder::instance()
+    {
+        // Intentionally leaked: the SDK's threads may record a frame
+        // while static objects are destroyed at exit
+        static FlightRecorder* sRecorder = NULL;
+        if (sRecorder == NULL) {
+            sRecorder = new FlightRecorder();
+            sRecorder->ref();
+        }
+        return sRecorder;
+    }
+
+    // Create the recorder at load time, so no thread has to race for the
+    // construction
+    static FlightRecorder* sInitFlightRecorder = FlightRecorder::instance();
+
+    FlightRecorder::FlightRecorder(): osg::Referenced(),
+        enabled_(true),
+        sequences_(NULL),
+        writeIndex_(0),
+        lastFrameID_(0),
+        signalFilename_("osgLeap-flight.txt")
+    {
+        const char* enabled = getenv("OSGLEAP_FLIGHTRECORDER");
+        if (enabled != NULL && std::string(enabled) == "0") {
+            enabled_ = false;
+        }
+        const char* filename = getenv("OSGLEAP_FLIGHTRECORDER_FILE");
+        if (filename != NULL && filename[0] != '\0') {
+            signalFilename_ = filename;
+        }
+
+        // About 20 seconds of tracking at 100 frames per second
+        setCapacity(2048);
+    }
+
+    FlightRecorder::~FlightRecorder()
+    {
+        enabled_ = false;
+        dumpThread_ = NULL;
+        delete [] sequences_;
+    }
+
+    void FlightRecorder::setCapacity(unsigned int numRecords)
+    {
+        if (numRecords == 0) numRecords = 1;
+        records_.assign(numRecords, Record());
+        delete [] sequences_;
+        sequences_ = new AtomicIndex[numRecords];
+        writeIndex_.exchange(0);
+    }
+
+    unsigned int FlightRecorder::claim()
+    {
+        unsigned int sequence = ++writeIndex_;
+        // 0 marks slots being written, skip it when wrapping around
+        if (sequence == 0) sequence = ++writeIndex_;
+        sequences_[(sequence-1) % records_.size()].store(0);
+        // The 0 must be visible before any write to the record
+        AtomicIndex::fence();
+        return sequence;
+    }
+
+    void FlightRecorder::publish(unsigned int sequence)
+    {
+        // Release: the record is complete before its sequence number
+        sequences_[(sequence-1) % records_.size()].store(sequence);
+    }
+
+    void FlightRecorder::recordFrame(const Leap::Frame& frame)
+    {
+        checkDumpRequest();
+        if (!enabled_ || !frame.isValid()) return;
+
+        // Listeners of the same controller are called one after another,
+        // so this filters all but the first of them
+        unsigned int frameID = (unsigned int)frame.id();
+        if (lastFrameID_.exchange(frameID) == frameID) return;
+
+        unsigned int sequence = claim();
+        Record& r = getRecord(sequence);
+        r.type = FRAME;
+        r.frameID = frame.id();
+        r.timestamp = frame.timestamp();
+        r.tick = osg::Timer::instance()->tick();
+        r.numHands = 0;
+        r.numItems = 0;
+
+        const Leap::HandList hands = frame.hands();
+        for (Leap::HandList::const_iterator itr = hands.begin(); itr != hands.end() && r.numItems < MAX_ITEMS; ++itr) {
+            const Leap::Vector pos = (*itr).palmPosition();
+            r.ids[r.numItems] = (*itr).id();
+            r.values[r.numItems][0] = pos.x;
+            r.values[r.numItems][1] = pos.y;
+            r.values[r.numItems][2] = pos.z;
+            ++r.numItems;
+        }
+        r.numHands = r.numItems;
+
+        const Leap::PointableList pointables = frame.pointables();
+        for (Leap::PointableList::const_iterator itr = pointables.begin(); itr != pointables.end() && r.numItems < MAX_ITEMS; ++itr) {
+            const Leap::Vector pos = (*itr).stabilizedTipPosition();
+            r.ids[r.numItems] = (*itr).id();
+            r.values[r.numItems][0] = pos.x;
+            r.values[r.numItems][1] = pos.y;
+            r.values[r.numItems][2] = pos.z;
+            ++r.numItems;
+        }
+
+        publish(sequence);
+    }
+
+    void FlightRecorder::recordClick(long long frameID, int pointableID, const osg::Vec2& position)
+    {
+        if (!enabled_) return;
+
+        unsigned int sequence = claim();
+        Record& r = getRecord(sequence);
+        r.type = CLICK;
+        r.frameID = frameID;
+        r.timestamp = 0;
+        r.tick = osg::Timer::instance()->tick();
+        r.numHands = 0;
+        r.numItems = 1;
+        r.ids[0] = pointableID;
+        r.values[0][0] = position.x();
+        r.values[0][1] = position.y();
+        r.values[0][2] = 0.0f;
+        publish(sequence);
+    }
+
+    void FlightRecorder::recordAction(long long frameID, int action, const osg::Vec3& palmVelocity)
+    {
+        if (!enabled_) return;
+
+        unsigned int sequence = claim();
+        Record& r = getRecord(sequence);
+        r.type = ACTION;
+        r.frameID = frameID;
+        r.timestamp = 0;
+        r.tick = osg::Timer::instance()->tick();
+        r.numHands = 0;
+        r.numItems = 1;
+        r.ids[0] = action;
+        r.values[0][0] = palmVelocity.x();
+        r.values[0][1] = palmVelocity.y();
+        r.values[0][2] = palmVelocity.z();
+        publish(sequence);
+    }
+
+    bool FlightRecorder::dump(const std::string& filename)
+    {
+        // Copy first, writers keep going meanwhile
+        std::vector<std::pair<unsigned int, Record> > copy;
+        copy.reserve(records_.size());
+        for (unsigned int i = 0; i < records_.size(); ++i) {
+            const unsigned int before = sequences_[i].load();
+            if (before == 0) continue;
+            Record r = records_[i];
+            // The copy must be complete before the sequence is read again
+            AtomicIndex::fence();
+            // Skip records overwritten while copying
+            if (sequences_[i].load() != before) continue;
+            copy.push_back(std::pair<unsigned int, Record>(before, r));
+        }
+        std::sort(copy.begin(), copy.end(), SequenceLess());
+
+        std::ofstream out(filename.c_str());
+        if (!out) {
+            OSG_WARN<<"osgLeap::FlightRecorder: Cannot write "<<filename<<std::endl;
+            return false;
+        }
+
+        static const char* typeNames[] = { "FRAME", "CLICK", "ACTION" };
+        const osg::Timer* timer = osg::Timer::instance();
+        const osg::Timer_t now = timer->tick();
+
+        out<<"# sequence type frame timestamp age[s] hands {id x y z}"<<std::endl;
+        for (std::vector<std::pair<unsigned int, Record> >::const_iterator itr = copy.begin(); itr != copy.end(); ++itr) {
+            const Record& r = itr->second;
+            out<<itr->first<<" "<<typeNames[r.type]<<" "<<r.frameID<<" "<<r.timestamp
+                <<" "<<timer->delta_s(r.tick, now)<<" "<<r.numHands;
+            for (unsigned int i = 0; i < r.numItems && i < MAX_ITEMS; ++i) {
+                out<<" "<<r.ids[i]<<" "<<r.values[i][0]<<" "<<r.values[i][1]<<" "<<r.values[i][2];
+            }
+            out<<std::endl;
+        }
+
+        OSG_NOTICE<<"osgLeap::FlightRecorder: Wrote "<<copy.size()<<" records to "<<filename<<std::endl;
+        return true;
+    }
+
+    bool FlightRecorder::dumpAsync(const std::string& filename)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(dumpMutex_);
+        FlightRecorderDumpThread* thread = static_cast<FlightRecorderDumpThread*>(dumpThread_.get());
+        if (thread != NULL && thread->isRunning()) return false;
+
+        thread = new FlightRecorderDumpThread(this, filename);
+        dumpThread_ = thread;
+        thread->start();
+        return true;
+    }
+
+    void FlightRecorder::installSignalHandler(int signum)
+    {
+#ifndef _WIN32
+        if (signum < 0) signum = SIGUSR1;
+        signal(signum, dumpSignalHandler);
+#else
+        OSG_WARN<<"osgLeap::FlightRecorder: Signal handlers are not supported on this platform, use dumpAsync()."<<std::endl;
+#endif
+    }
+
+    void FlightRecorder::checkDumpRequest()
+    {
+        if (sDumpRequested != 0) {
+            sDumpRequested = 0;
+            dumpAsync(signalFilename_);
+        }
+    }
+
+} /* namespace osgLeap */
@@ -0,0 +1,262 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/FrameHistory>
+
+//-- OSG: osg --//
+#include <osg/Vec3d>
+
+//-- STL --//
+#include <cmath>
+
+namespace osgLeap {
+
+    static osg::Vec3 toVec3(const Leap::Vector& v)
+    {
+        return osg::Vec3(v.x, v.y, v.z);
+    }
+
+    static osg::Vec3 lerp(const osg::Vec3& a, const osg::Vec3& b, float t)
+    {
+        return a+(b-a)*t;
+    }
+
+    const FrameHistory::HandRecord* FrameHistory::FrameRecord::findHand(int handID) const
+    {
+        for (unsigned int i = 0; i < numHands; ++i) {
+            if (hands[i].id == handID) return &hands[i];
+        }
+        return NULL;
+    }
+
+    const FrameHistory::PointableRecord* FrameHistory::FrameRecord::findPointable(int pointableID) const
+    {
+        for (unsigned int i = 0; i < numPointables; ++i) {
+            if (pointables[i].id == pointableID) return &pointables[i];
+        }
+        return NULL;
+    }
+
+    FrameHistory::FrameHistory(unsigned int capacity): osg::Referenced(),
+        records_(capacity > 0 ? capacity : 1),
+        head_(0),
+        size_(0)
+    {
+
+    }
+
+    bool FrameHistory::push(const Leap::Frame& frame)
+    {
+        if (!frame.isValid()) return false;
+        if (size_ > 0 && frame.id() <= byAge(0)->id) return false;
+
+        head_ = (head_+1) % records_.size();
+        if (size_ < records_.size()) ++size_;
+
+        FrameRecord& r = records_[head_];
+        r.id = frame.id();
+        r.timestamp = frame.timestamp();
+        r.numHands = 0;
+        r.numPointables = 0;
+
+        const Leap::HandList hands = frame.hands();
+        for (Leap::HandList::const_iterator itr = hands.begin(); itr != hands.end() && r.numHands < MAX_HANDS; ++itr) {
+            HandRecord& h = r.hands[r.numHands++];
+            h.id = (*itr).id();
+#ifdef LEAPSDK_1X_COMPATIBILITY
+            h.isLeft = false;
+            h.grabStrength = 0.0f;
+#else
+            h.isLeft = (*itr).isLeft();
+            h.grabStrength = (*itr).grabStrength();
+#endif
+            h.palmPosition = toVec3((*itr).palmPosition());
+            h.palmNormal = toVec3((*itr).palmNormal());
+            h.direction = toVec3((*itr).direction());
+            h.palmVelocity = toVec3((*itr).palmVelocity());
+        }
+
+        const Leap::PointableList pointables = frame.pointables();
+        for (Leap::PointableList::const_iterator itr = pointables.begin(); itr != pointables.end() && r.numPointables < MAX_POINTABLES; ++itr) {
+            PointableRecord& p = r.pointables[r.numPointables++];
+            p.id = (*itr).id();
+            p.handID = (*itr).hand().id();
+            p.tipPosition = toVec3((*itr).tipPosition());
+            p.stabilizedTipPosition = toVec3((*itr).stabilizedTipPosition());
+            p.direction = toVec3((*itr).direction());
+        }
+
+        return true;
+    }
+
+    bool FrameHistory::findTimestamp(long long timestamp, unsigned int& olderAge, float& t) const
+    {
+        olderAge = 0;
+        t = 0.0f;
+        if (size_ == 0) return false;
+
+        if (timestamp >= byAge(0)->timestamp) {
+            return (timestamp == byAge(0)->timestamp);
+        }
+        if (timestamp < byAge(size_-1)->timestamp) {
+            olderAge = size_-1;
+            return false;
+        }
+
+        // Timestamps decrease with age: find the youngest record not newer
+        // than timestamp
+        unsigned int lo = 1;
+        unsigned int hi = size_-1;
+        while (lo < hi) {
+            unsigned int mid = (lo+hi)/2;
+            if (byAge(mid)->timestamp <= timestamp) {
+                hi = mid;
+            } else {
+                lo = mid+1;
+            }
+        }
+
+        olderAge = lo;
+        const long long older = byAge(lo)->timestamp;
+        const long long newer = byAge(lo-1)->timestamp;
+        t = (newer > older) ? (float)(timestamp-older)/(float)(newer-older) : 0.0f;
+        return true;
+    }
+
+    bool FrameHistory::getHandAt(int handID, long long timestamp, HandRecord& hand) const
+    {
+        unsigned int olderAge = 0;
+        float t = 0.0f;
+        findTimestamp(timestamp, olderAge, t);
+        if (size_ == 0) return false;
+
+        const HandRecord* a = byAge(olderAge)->findHand(handID);
+        const HandRecord* b = (olderAge > 0) ? byAge(olderAge-1)->findHand(handID) : a;
+        if (a == NULL || b == NULL) {
+            if (a == NULL) a = b;
+            if (a == NULL) return false;
+            hand = *a;
+            return true;
+        }
+
+        hand = *a;
+        hand.grabStrength = a->grabStrength+(b->grabStrength-a->grabStrength)*t;
+        hand.palmPosition = lerp(a->palmPosition, b->palmPosition, t);
+        hand.palmNormal = lerp(a->palmNormal, b->palmNormal, t);
+        hand.palmNormal.normalize();
+        hand.direction = lerp(a->direction, b->direction, t);
+        hand.direction.normalize();
+        hand.palmVelocity = lerp(a->palmVelocity, b->palmVelocity, t);
+        return true;
+    }
+
+    bool FrameHistory::getPointableAt(int pointableID, long long timestamp, PointableRecord& pointable) const
+    {
+        unsigned int olderAge = 0;
+        float t = 0.0f;
+        findTimestamp(timestamp, olderAge, t);
+        if (size_ == 0) return false;
+
+        const PointableRecord* a = byAge(olderAge)->findPointable(pointableID);
+        const PointableRecord* b = (olderAge > 0) ? byAge(olderAge-1)->findPointable(pointableID) : a;
+        if (a == NULL || b == NULL) {
+            if (a == NULL) a = b;
+            if (a == NULL) return false;
+            pointable = *a;
+            return true;
+        }
+
+        pointable = *a;
+        pointable.tipPosition = lerp(a->tipPosition, b->tipPosition, t);
+        pointable.stabilizedTipPosition = lerp(a->stabilizedTipPosition, b->stabilizedTipPosition, t);
+        pointable.direction = lerp(a->direction, b->direction, t);
+        pointable.direction.normalize();
+        return true;
+    }
+
+    bool FrameHistory::getHandMotion(int handID, unsigned int window, osg::Vec3& velocity, osg::Vec3* acceleration) const
+    {
+        return fitMotion(true, handID, window, velocity, acceleration);
+    }
+
+    bool FrameHistory::getPointableMotion(int pointableID, unsigned int window, osg::Vec3& velocity, osg::Vec3* acceleration) const
+    {
+        return fitMotion(false, pointableID, window, velocity, acceleration);
+    }
+
+    bool FrameHistory::fitMotion(bool hand, int id, unsigned int window, osg::Vec3& velocity, osg::Vec3* acceleration) const
+    {
+        velocity.set(0.0f, 0.0f, 0.0f);
+        if (acceleration != NULL) acceleration->set(0.0f, 0.0f, 0.0f);
+
+        // Sums of t^k and of t^k*position, t in seconds relative to the
+        // newest sample (t <= 0)
+        double st[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+        osg::Vec3d sp[3];
+        unsigned int n = 0;
+        long long t0 = 0;
+
+        for (unsigned int age = 0; age < size_ && n < window; ++age) {
+            const FrameRecord* r = byAge(age);
+            osg::Vec3 pos;
+            if (hand) {
+                const HandRecord* h = r->findHand(id);
+                if (h == NULL) continue;
+                pos = h->palmPosition;
+            } else {
+                const PointableRecord* p = r->findPointable(id);
+                if (p == NULL) continue;
+                pos = p->tipPosition;
+            }
+
+            if (n == 0) t0 = r->timestamp;
+            const double t = (double)(r->timestamp-t0)*1.0e-6;
+            double tk = 1.0;
+            for (unsigned int k = 0; k < 5; ++k) {
+                st[k] += tk;
+                if (k < 3) sp[k] += osg::Vec3d(pos)*tk;
+                tk *= t;
+            }
+            ++n;
+        }
+
+        if (n < 2) return false;
+
+        if (acceleration != NULL && n >= 3) {
+            // p(t) = a + b*t + c*t^2: solve the normal equations by Cramer's rule
+            const double det = st[0]*(st[2]*st[4]-st[3]*st[3])
+                -st[1]*(st[1]*st[4]-st[3]*st[2])
+                +st[2]*(st[1]*st[3]-st[2]*st[2]);
+            if (std::fabs(det) > 1.0e-18) {
+                for (unsigned int i = 0; i < 3; ++i) {
+                    const double y0 = sp[0][i], y1 = sp[1][i], y2 = sp[2][i];
+                    const double detB = st[0]*(y1*st[4]-st[3]*y2)
+                        -y0*(st[1]*st[4]-st[3]*st[2])
+                        +st[2]*(st[1]*y2-y1*st[2]);
+                    const double detC = st[0]*(st[2]*y2-y1*st[3])
+                        -st[1]*(st[1]*y2-y1*st[2])
+                        +y0*(st[1]*st[3]-st[2]*st[2]);
+                    velocity[i] = (float)(detB/det);
+                    (*acceleration)[i] = (float)(2.0*detC/det);
+                }
+                return true;
+            }
+        }
+
+        // p(t) = a + b*t
+        const double det = st[0]*st[2]-st[1]*st[1];
+        if (std::fabs(det) < 1.0e-18) return false;
+        for (unsigned int i = 0; i < 3; ++i) {
+            velocity[i] = (float)((st[0]*sp[1][i]-st[1]*sp[0][i])/det);
+        }
+        return true;
+    }
+
+} /* namespace osgLeap */
@@ -0,0 +1,231 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/FrameProcessingGraph>
+
+//-- Project --//
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/Notify>
+
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+//-- STL --//
+#include <sstream>
+
+namespace osgLeap {
+
+    class FrameProcessingWorker: public osg::Referenced, public OpenThreads::Thread {
+    public:
+        FrameProcessingWorker(FrameProcessingGraph* graph, unsigned int index): osg::Referenced(), OpenThreads::Thread(),
+            graph_(graph),
+            index_(index)
+        {
+
+        }
+
+        virtual void run()
+        {
+            std::ostringstream name;
+            name<<"osgLeap::FrameProcessingGraph "<<index_;
+            TraceRecorder::instance()->setThreadName(name.str());
+
+            while (graph_->runNextStage()) {}
+        }
+
+    protected:
+        virtual ~FrameProcessingWorker()
+        {
+            if (isRunning()) join();
+        }
+
+        FrameProcessingGraph* graph_;
+        unsigned int index_;
+    };
+
+    FrameProcessingGraph::FrameProcessingGraph(unsigned int numThreads): osg::Referenced(), Leap::Listener(),
+        hasPending_(false),
+        running_(false),
+        numWaiting_(0),
+        remaining_(0),
+        done_(false),
+        numProcessed_(0),
+        numDropped_(0)
+    {
+        if (numThreads == 0) numThreads = 1;
+        for (unsigned int i = 0; i < numThreads; ++i) {
+            FrameProcessingWorker* worker = new FrameProcessingWorker(this, i);
+            workers_.push_back(worker);
+            worker->start();
+        }
+        controller_.addListener(*this);
+    }
+
+    FrameProcessingGraph::~FrameProcessingGraph()
+    {
+        controller_.removeListener(*this);
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            done_ = true;
+            condition_.broadcast();
+        }
+        // Joins the workers
+        workers_.clear();
+    }
+
+    void FrameProcessingGraph::rebuild(const std::vector<osg::ref_ptr<Stage> >& stages)
+    {
+        nodes_.clear();
+        nodes_.resize(stages.size());
+        for (unsigned int i = 0; i < stages.size(); ++i) {
+            Node& node = nodes_[i];
+            node.stage = stages[i];
+            node.numDependencies = 0;
+            node.remaining = 0;
+
+            const std::vector<Stage*>& dependencies = stages[i]->getDependencies();
+            for (std::vector<Stage*>::const_iterator itr = dependencies.begin(); itr != dependencies.end(); ++itr) {
+                unsigned int d = 0;
+                while (d < i && stages[d].get() != *itr) ++d;
+                if (d == i) {
+                    OSG_WARN<<"osgLeap::FrameProcessingGraph: Stage "<<stages[i]->getName()
+                        <<" depends on a stage that was not added before, ignoring the dependency."<<std::endl;
+                    continue;
+                }
+                nodes_[d].dependents.push_back(i);
+                ++node.numDependencies;
+            }
+        }
+        ready_.reserve(nodes_.size());
+    }
+
+    void FrameProcessingGraph::waitForRun()
+    {
+        ++numWaiting_;
+        while (running_) {
+            condition_.wait(&mutex_);
+        }
+        --numWaiting_;
+    }
+
+    void FrameProcessingGraph::startPending()
+    {
+        if (running_ || !hasPending_ || numWaiting_ > 0) return;
+        hasPending_ = false;
+        startRun(pending_);
+        pending_ = Leap::Frame();
+    }
+
+    void FrameProcessingGraph::addStage(Stage* stage)
+    {
+        if (stage == NULL) return;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        waitForRun();
+        std::vector<osg::ref_ptr<Stage> > stages;
+        for (std::vector<Node>::const_iterator itr = nodes_.begin(); itr != nodes_.end(); ++itr) {
+            if (itr->stage.get() == stage) break;
+            stages.push_back(itr->stage);
+        }
+        if (stages.size() == nodes_.size()) {
+            stages.push_back(stage);
+            rebuild(stages);
+        }
+        startPending();
+    }
+
+    void FrameProcessingGraph::removeStage(Stage* stage)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        waitForRun();
+        std::vector<osg::ref_ptr<Stage> > stages;
+        for (std::vector<Node>::const_iterator itr = nodes_.begin(); itr != nodes_.end(); ++itr) {
+            if (itr->stage.get() != stage) stages.push_back(itr->stage);
+        }
+        rebuild(stages);
+        startPending();
+    }
+
+    void FrameProcessingGraph::startRun(const Leap::Frame& frame)
+    {
+        if (nodes_.empty()) return;
+
+        current_ = frame;
+        running_ = true;
+        remaining_ = nodes_.size();
+        ready_.clear();
+        for (unsigned int i = 0; i < nodes_.size(); ++i) {
+            nodes_[i].remaining = nodes_[i].numDependencies;
+            if (nodes_[i].remaining == 0) ready_.push_back(i);
+        }
+        condition_.broadcast();
+    }
+
+    void FrameProcessingGraph::submit(const Leap::Frame& frame)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        // Keep the newest frame only, it is picked up when the current one
+        // is done
+        if (hasPending_) ++numDropped_;
+        pending_ = frame;
+        hasPending_ = true;
+        startPending();
+    }
+
+    void FrameProcessingGraph::onFrame(const Leap::Controller& controller)
+    {
+        submit(controller.frame());
+    }
+
+    bool FrameProcessingGraph::runNextStage()
+    {
+        unsigned int index = 0;
+        Stage* stage = NULL;
+        Leap::Frame frame;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            while (!done_ && ready_.empty()) {
+                condition_.wait(&mutex_);
+            }
+            if (done_) return false;
+            index = ready_.back();
+            ready_.pop_back();
+            // The node list does not change while a frame is processed
+            stage = nodes_[index].stage.get();
+            frame = current_;
+        }
+
+        {
+            OSGLEAP_TRACE_SPAN(span, "FrameProcessingGraph::Stage");
+            span.setFrameID(frame.id());
+            stage->process(frame);
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        const std::vector<unsigned int>& dependents = nodes_[index].dependents;
+        for (std::vector<unsigned int>::const_iterator itr = dependents.begin(); itr != dependents.end(); ++itr) {
+            if (--nodes_[*itr].remaining == 0) ready_.push_back(*itr);
+        }
+        if (--remaining_ == 0) {
+            running_ = false;
+            ++numProcessed_;
+            current_ = Leap::Frame();
+            startPending();
+        }
+        // Wake up workers for the stages that became ready, and anybody
+        // waiting for the run to finish
+        condition_.broadcast();
+        return true;
+    }
+
+} /* namespace osgLeap */
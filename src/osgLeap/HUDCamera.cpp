@@ -10,6 +10,10 @@
 
 #include <osgLeap/HUDCamera>
 
+//-- OSG: osg --//
+#include <osg/BlendFunc>
+#include <osg/Geometry>
+
 //-- OSG: osgDB --//
 #include <osgDB/ReadFile>
 
@@ -18,7 +22,8 @@ namespace osgLeap {
     class ResizeUpdateCallback: public osg::NodeCallback
     {
     public:
-        ResizeUpdateCallback(osg::Camera* masterCamera, osg::Camera* slaveCamera): masterCamera_(masterCamera), slaveCamera_(slaveCamera)
+        ResizeUpdateCallback(osg::Camera* masterCamera, HUDCamera* slaveCamera): masterCamera_(masterCamera), slaveCamera_(slaveCamera),
+            windowwidth_(-1), windowheight_(-1)
         {
 
         }
@@ -26,29 +31,75 @@ namespace osgLeap {
         virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
         {
 			if (masterCamera_->getViewport() != NULL) {
-				float windowheight = masterCamera_->getViewport()->height();
-				float windowwidth  = masterCamera_->getViewport()->width();
-				
-				slaveCamera_->setProjectionMatrix(osg::Matrix::ortho2D(0, windowwidth, 0, windowheight));
+				int windowheight = masterCamera_->getViewport()->height();
+				int windowwidth  = masterCamera_->getViewport()->width();
+
+				// Rebuild projection only if the viewport has changed
+				if (windowwidth != windowwidth_ || windowheight != windowheight_) {
+					slaveCamera_->resize(windowwidth, windowheight);
+					windowwidth_ = windowwidth;
+					windowheight_ = windowheight;
+				}
 			} else {
 				OSG_WARN<<"WARN: ResizeUpdateCallback::operator() -- masterCamera_ has no osg::Viewport defined!"<<std::endl;
 			}
+            // Update the HUD content first, so changes made during this
+            // update traversal are rendered in this frame
             traverse(node, nv);
+            if (nv->getFrameStamp() != NULL) {
+                slaveCamera_->updateCache(nv->getFrameStamp()->getFrameNumber());
+            }
         }
 
     private:
         osg::Camera* masterCamera_;
-        osg::Camera* slaveCamera_;
+        HUDCamera* slaveCamera_;
+        int windowwidth_;
+        int windowheight_;
     };
 
-    HUDCamera::HUDCamera(osg::Camera* masterCamera): osg::Camera()
+    // Lets the render-to-texture camera of a cached HUDCamera through the
+    // cull traversal only once in frames where the content has changed
+    class CacheCullCallback: public osg::NodeCallback
+    {
+    public:
+        CacheCullCallback(HUDCamera* hud): hud_(hud), lastFrameNumber_(0), culled_(false)
+        {
+
+        }
+
+        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            const osg::FrameStamp* fs = nv->getFrameStamp();
+            if (fs == NULL || fs->getFrameNumber() != hud_->getRenderFrameNumber()) return;
+            // In stereo modes the HUD is culled once per eye. The texture
+            // rendered for the first eye is used for the second one, too.
+            if (culled_ && lastFrameNumber_ == fs->getFrameNumber()) return;
+            culled_ = true;
+            lastFrameNumber_ = fs->getFrameNumber();
+            traverse(node, nv);
+        }
+
+    private:
+        HUDCamera* hud_;
+        unsigned int lastFrameNumber_;
+        bool culled_;
+    };
+
+    HUDCamera::HUDCamera(osg::Camera* masterCamera): osg::Camera(),
+        dirty_(true),
+        renderFrameNumber_(0),
+        width_(0),
+        height_(0)
     {
         // Initialize UpdateCallback to update myself during updateTraversal
         addUpdateCallback(new ResizeUpdateCallback(masterCamera, this));
 
         // set the projection matrix
 		if (masterCamera->getViewport() != NULL) {
-			setProjectionMatrix(osg::Matrix::ortho2D(0, masterCamera->getViewport()->width(), 0, masterCamera->getViewport()->height()));
+			width_ = masterCamera->getViewport()->width();
+			height_ = masterCamera->getViewport()->height();
+			setProjectionMatrix(osg::Matrix::ortho2D(0, width_, 0, height_));
 		} else {
 			OSG_WARN<<"WARN: HUDCamera::HUDCamera(osg::Camera* masterCamera) -- masterCamera has no osg::Viewport defined!"<<std::endl;
 		}
@@ -75,9 +126,151 @@ namespace osgLeap {
     }
 
     HUDCamera::HUDCamera(const HUDCamera& hs,
-        const osg::CopyOp& copyOp): osg::Camera(hs)
+        const osg::CopyOp& copyOp): osg::Camera(hs),
+        dirty_(true),
+        renderFrameNumber_(0),
+        width_(hs.width_),
+        height_(hs.height_)
+    {
+
+    }
+
+    void HUDCamera::dirtyParents(osg::Node* node)
+    {
+        for (unsigned int i = 0; i < node->getNumParents(); ++i) {
+            osg::Group* parent = node->getParent(i);
+            HUDCamera* hud = dynamic_cast<HUDCamera*>(parent);
+            if (hud != NULL) {
+                hud->dirty();
+            } else {
+                dirtyParents(parent);
+            }
+        }
+    }
+
+    bool HUDCamera::hasCachedParent(osg::Node* node)
+    {
+        for (unsigned int i = 0; i < node->getNumParents(); ++i) {
+            osg::Group* parent = node->getParent(i);
+            HUDCamera* hud = dynamic_cast<HUDCamera*>(parent);
+            if (hud != NULL) {
+                if (hud->getCachedRendering()) return true;
+            } else if (hasCachedParent(parent)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    osg::Group* HUDCamera::getContentGroup()
+    {
+        if (rttCamera_.valid()) return rttCamera_.get();
+        return this;
+    }
+
+    bool HUDCamera::addChild(osg::Node* child)
+    {
+        dirty();
+        if (rttCamera_.valid()) return rttCamera_->addChild(child);
+        return osg::Camera::addChild(child);
+    }
+
+    void HUDCamera::setCachedRendering(bool cached)
     {
+        if (cached == getCachedRendering()) return;
 
+        if (cached) {
+            cacheTexture_ = new osg::Texture2D();
+            cacheTexture_->setTextureSize(width_, height_);
+            cacheTexture_->setInternalFormat(GL_RGBA);
+            cacheTexture_->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+            cacheTexture_->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+            cacheTexture_->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+            cacheTexture_->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+            cacheTexture_->setResizeNonPowerOfTwoHint(false);
+
+            // Render the content into cacheTexture_ before the HUD is drawn
+            rttCamera_ = new osg::Camera();
+            rttCamera_->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+            rttCamera_->setViewMatrix(osg::Matrix::identity());
+            rttCamera_->setProjectionMatrix(getProjectionMatrix());
+            rttCamera_->setViewport(0, 0, width_, height_);
+            rttCamera_->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+            rttCamera_->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            rttCamera_->setRenderOrder(osg::Camera::PRE_RENDER);
+            rttCamera_->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+            rttCamera_->attach(osg::Camera::COLOR_BUFFER, cacheTexture_.get());
+            rttCamera_->setAllowEventFocus(false);
+            rttCamera_->setCullCallback(new CacheCullCallback(this));
+
+            // Move the content below the render-to-texture camera
+            for (unsigned int i = 0; i < getNumChildren(); ++i) {
+                rttCamera_->addChild(getChild(i));
+            }
+            removeChildren(0, getNumChildren());
+
+            osg::Camera::addChild(rttCamera_.get());
+            createCacheQuad();
+        } else {
+            removeChild(cacheQuad_.get());
+            removeChild(rttCamera_.get());
+            for (unsigned int i = 0; i < rttCamera_->getNumChildren(); ++i) {
+                osg::Camera::addChild(rttCamera_->getChild(i));
+            }
+            rttCamera_ = NULL;
+            cacheTexture_ = NULL;
+            cacheQuad_ = NULL;
+        }
+        dirty();
+    }
+
+    void HUDCamera::createCacheQuad()
+    {
+        if (cacheQuad_.valid()) {
+            removeChild(cacheQuad_.get());
+        }
+
+        cacheQuad_ = new osg::Geode();
+        osg::ref_ptr<osg::Geometry> geom = osg::createTexturedQuadGeometry(osg::Vec3(0.0f, 0.0f, 0.0f),
+            osg::Vec3(width_, 0.0f, 0.0f), osg::Vec3(0.0f, height_, 0.0f));
+        cacheQuad_->addDrawable(geom);
+
+        osg::StateSet* ss = cacheQuad_->getOrCreateStateSet();
+        ss->setTextureAttributeAndModes(0, cacheTexture_.get(), osg::StateAttribute::ON);
+        ss->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+        ss->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+        // The texture was rendered onto transparent black, so its colors
+        // are already weighted by alpha
+        ss->setAttributeAndModes(new osg::BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA), osg::StateAttribute::ON);
+        ss->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+
+        osg::Camera::addChild(cacheQuad_.get());
+    }
+
+    void HUDCamera::resize(int width, int height)
+    {
+        width_ = width;
+        height_ = height;
+        setProjectionMatrix(osg::Matrix::ortho2D(0, width_, 0, height_));
+
+        if (rttCamera_.valid()) {
+            rttCamera_->setProjectionMatrix(getProjectionMatrix());
+            rttCamera_->setViewport(0, 0, width_, height_);
+            cacheTexture_->setTextureSize(width_, height_);
+            cacheTexture_->dirtyTextureObject();
+            // Force the frame buffer object to be recreated at the new size
+            rttCamera_->setRenderingCache(NULL);
+            createCacheQuad();
+        }
+        dirty();
+    }
+
+    void HUDCamera::updateCache(unsigned int frameNumber)
+    {
+        if (dirty_) {
+            renderFrameNumber_ = frameNumber;
+            dirty_ = false;
+        }
     }
 
 }
@@ -0,0 +1,265 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/HandSkeleton>
+
+//-- Project --//
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/Geometry>
+#include <osg/Program>
+#include <osg/Shader>
+#include <osg/TextureBuffer>
+
+//-- STL --//
+#include <cmath>
+
+namespace osgLeap {
+
+    // Number of segments around the capsule axis and rings per hemisphere
+    static const unsigned int CAPSULE_SEGMENTS = 12;
+    static const unsigned int CAPSULE_RINGS = 4;
+
+    // Texture unit of the instance data
+    static const int INSTANCE_DATA_UNIT = 0;
+
+    // Builds the capsule from end a to end b in the instance's frame. The
+    // capsule mesh is a unit sphere split at the equator; gl_MultiTexCoord0.x
+    // tells whether a vertex belongs to end a (0) or end b (1).
+    static const char* sHandSkeletonVertexShader =
+        "#version 120\n"
+        "#extension GL_EXT_gpu_shader4 : enable\n"
+        "#extension GL_EXT_draw_instanced : enable\n"
+        "uniform samplerBuffer osgLeap_InstanceData;\n"
+        "varying vec3 normal;\n"
+        "varying float shade;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 a = texelFetchBuffer(osgLeap_InstanceData, 2*gl_InstanceID);\n"
+        "    vec4 b = texelFetchBuffer(osgLeap_InstanceData, 2*gl_InstanceID+1);\n"
+        "    vec3 axis = b.xyz-a.xyz;\n"
+        "    float len = length(axis);\n"
+        "    vec3 z = (len > 0.0001) ? axis/len : vec3(0.0, 0.0, 1.0);\n"
+        "    vec3 up = (abs(z.z) < 0.999) ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);\n"
+        "    vec3 x = normalize(cross(up, z));\n"
+        "    vec3 y = cross(z, x);\n"
+        "    vec3 n = x*gl_Vertex.x+y*gl_Vertex.y+z*gl_Vertex.z;\n"
+        "    vec3 center = mix(a.xyz, b.xyz, gl_MultiTexCoord0.x);\n"
+        "    normal = normalize(gl_NormalMatrix*n);\n"
+        "    shade = b.w;\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix*vec4(center+a.w*n, 1.0);\n"
+        "}\n";
+
+    static const char* sHandSkeletonFragmentShader =
+        "#version 120\n"
+        "uniform vec4 osgLeap_HandColor;\n"
+        "varying vec3 normal;\n"
+        "varying float shade;\n"
+        "void main()\n"
+        "{\n"
+        "    float diffuse = max(dot(normalize(normal), vec3(0.0, 0.0, 1.0)), 0.0);\n"
+        "    gl_FragColor = vec4(osgLeap_HandColor.rgb*shade*(0.3+0.7*diffuse), osgLeap_HandColor.a);\n"
+        "}\n";
+
+    // UpdateCallback "auto-updates" the osgLeap::HandSkeleton Geode from
+    // within the update traversal of the osgViewer
+    class HandSkeletonUpdateCallback: public osg::NodeCallback
+    {
+    public:
+        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            HandSkeleton* hs = dynamic_cast<HandSkeleton*>(node);
+            if (hs) {
+                hs->update();
+            }
+            traverse(node, nv);
+        }
+    };
+
+    HandSkeleton::HandSkeleton(unsigned int maxHands): osg::Geode(), Leap::Listener(),
+        lastFrameID_(-1),
+        maxHands_(maxHands > 0 ? maxHands : 1),
+        instanceData_(NULL),
+        color_(new osg::Uniform("osgLeap_HandColor", osg::Vec4(0.9f, 0.75f, 0.6f, 1.0f)))
+    {
+        createSkeleton();
+        addUpdateCallback(new HandSkeletonUpdateCallback());
+        controller_.addListener(*this);
+    }
+
+    HandSkeleton::HandSkeleton(const HandSkeleton& hs,
+        const osg::CopyOp& copyOp): osg::Geode(), Leap::Listener(),
+        lastFrameID_(-1),
+        maxHands_(hs.maxHands_),
+        instanceData_(NULL),
+        color_(new osg::Uniform("osgLeap_HandColor", osg::Vec4(0.9f, 0.75f, 0.6f, 1.0f)))
+    {
+        // The instance data must not be shared, so build a new skeleton
+        color_->set(hs.color_->getElement<osg::Vec4>(0));
+        createSkeleton();
+        addUpdateCallback(new HandSkeletonUpdateCallback());
+        controller_.addListener(*this);
+    }
+
+    HandSkeleton::~HandSkeleton()
+    {
+        controller_.removeListener(*this);
+    }
+
+    void HandSkeleton::createSkeleton()
+    {
+        const unsigned int numInstances = maxHands_*INSTANCES_PER_HAND;
+
+        // Unit capsule: the lower hemisphere belongs to end a, the upper one
+        // to end b. Both contain the equator, so the band in between becomes
+        // the cylinder.
+        osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array();
+        osg::ref_ptr<osg::FloatArray> ends = new osg::FloatArray();
+        for (unsigned int half = 0; half < 2; ++half) {
+            for (unsigned int r = 0; r <= CAPSULE_RINGS; ++r) {
+                double lat = osg::PI_2*((double)(half*CAPSULE_RINGS+r)/CAPSULE_RINGS-1.0);
+                for (unsigned int s = 0; s <= CAPSULE_SEGMENTS; ++s) {
+                    double lon = 2.0*osg::PI*s/CAPSULE_SEGMENTS;
+                    va->push_back(osg::Vec3(cos(lat)*cos(lon), cos(lat)*sin(lon), sin(lat)));
+                    ends->push_back((float)half);
+                }
+            }
+        }
+
+        osg::ref_ptr<osg::DrawElementsUShort> triangles = new osg::DrawElementsUShort(osg::PrimitiveSet::TRIANGLES);
+        const unsigned int numRings = 2*(CAPSULE_RINGS+1);
+        const unsigned int ringSize = CAPSULE_SEGMENTS+1;
+        for (unsigned int r = 0; r+1 < numRings; ++r) {
+            for (unsigned int s = 0; s < CAPSULE_SEGMENTS; ++s) {
+                unsigned short i0 = r*ringSize+s;
+                unsigned short i1 = i0+1;
+                unsigned short i2 = i0+ringSize;
+                unsigned short i3 = i2+1;
+                triangles->push_back(i0); triangles->push_back(i1); triangles->push_back(i3);
+                triangles->push_back(i0); triangles->push_back(i3); triangles->push_back(i2);
+            }
+        }
+        triangles->setNumInstances(numInstances);
+
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+        geom->setUseDisplayList(false);
+        geom->setUseVertexBufferObjects(true);
+        geom->setVertexArray(va);
+        geom->setTexCoordArray(0, ends);
+        geom->addPrimitiveSet(triangles);
+        // The mesh does not know where the instances are, so cover the
+        // tracking volume of the device (millimeters)
+        geom->setInitialBound(osg::BoundingBox(-400.0f, 0.0f, -400.0f, 400.0f, 700.0f, 400.0f));
+        addDrawable(geom);
+
+        // Fixed size instance buffer, all instances hidden initially
+        instanceData_ = new osg::Image();
+        instanceData_->allocateImage(2*numInstances, 1, 1, GL_RGBA, GL_FLOAT);
+        instanceData_->setInternalTextureFormat(GL_RGBA32F_ARB);
+        hideInstances(0, numInstances);
+
+        osg::ref_ptr<osg::TextureBuffer> tbo = new osg::TextureBuffer();
+        tbo->setImage(instanceData_);
+        tbo->setInternalFormat(GL_RGBA32F_ARB);
+
+        osg::ref_ptr<osg::Program> program = new osg::Program();
+        program->addShader(new osg::Shader(osg::Shader::VERTEX, sHandSkeletonVertexShader));
+        program->addShader(new osg::Shader(osg::Shader::FRAGMENT, sHandSkeletonFragmentShader));
+
+        osg::StateSet* ss = getOrCreateStateSet();
+        ss->setAttributeAndModes(program);
+        ss->setTextureAttribute(INSTANCE_DATA_UNIT, tbo);
+        ss->addUniform(new osg::Uniform("osgLeap_InstanceData", INSTANCE_DATA_UNIT));
+        ss->addUniform(color_);
+        // update() rewrites the buffer every frame. Only DYNAMIC StateSets
+        // and Drawables hold back the next frame's update while drawing
+        // (DrawThreadPerContext), so the texture's StateSet must be one.
+        ss->setDataVariance(osg::Object::DYNAMIC);
+
+        setDataVariance(osg::Object::DYNAMIC);
+    }
+
+    void HandSkeleton::setInstance(unsigned int index, const osg::Vec3& a, const osg::Vec3& b, float radius, float shade)
+    {
+        float* data = reinterpret_cast<float*>(instanceData_->data())+8*index;
+        data[0] = a.x(); data[1] = a.y(); data[2] = a.z(); data[3] = radius;
+        data[4] = b.x(); data[5] = b.y(); data[6] = b.z(); data[7] = shade;
+    }
+
+    void HandSkeleton::hideInstances(unsigned int first, unsigned int last)
+    {
+        for (unsigned int i = first; i < last; ++i) {
+            setInstance(i, osg::Vec3(), osg::Vec3(), 0.0f, 1.0f);
+        }
+    }
+
+    void HandSkeleton::onFrame(const Leap::Controller& controller)
+    {
+        // Get the most recent frame and pass it to update(...)
+        frames_.post(controller.frame());
+    }
+
+    void HandSkeleton::update()
+    {
+        OSGLEAP_TRACE_SPAN(span, "HandSkeleton::update");
+        // Grab the frame to work on ...
+        const Leap::Frame frame = frames_.fetch();
+        if (frame.id() == lastFrameID_) return;
+        lastFrameID_ = frame.id();
+        span.setFrameID(frame.id());
+
+        const Leap::HandList hands = frame.hands();
+        unsigned int h = 0;
+        for (Leap::HandList::const_iterator itr = hands.begin(); itr != hands.end() && h < maxHands_; ++itr, ++h) {
+            const Leap::Hand hand = *itr;
+            const unsigned int base = h*INSTANCES_PER_HAND;
+            unsigned int index = base;
+
+            const Leap::Vector palm = hand.palmPosition();
+            const osg::Vec3 palmPos(palm.x, palm.y, palm.z);
+#ifdef LEAPSDK_1X_COMPATIBILITY
+            setInstance(index++, palmPos, palmPos, 20.0f, 0.8f);
+            // No bones available, show a capsule along each finger
+            const Leap::FingerList fingers = hand.fingers();
+            for (Leap::FingerList::const_iterator fitr = fingers.begin(); fitr != fingers.end() && index+2 <= base+INSTANCES_PER_HAND; ++fitr) {
+                const Leap::Vector tip = (*fitr).tipPosition();
+                const Leap::Vector root = tip-(*fitr).direction()*(*fitr).length();
+                const float radius = 0.5f*(*fitr).width();
+                setInstance(index++, osg::Vec3(root.x, root.y, root.z), osg::Vec3(tip.x, tip.y, tip.z), 0.7f*radius, 1.0f);
+                setInstance(index++, osg::Vec3(tip.x, tip.y, tip.z), osg::Vec3(tip.x, tip.y, tip.z), radius, 0.8f);
+            }
+#else
+            setInstance(index++, palmPos, palmPos, 0.2f*hand.palmWidth(), 0.8f);
+            const Leap::FingerList fingers = hand.fingers();
+            for (Leap::FingerList::const_iterator fitr = fingers.begin(); fitr != fingers.end() && index+9 <= base+INSTANCES_PER_HAND; ++fitr) {
+                const Leap::Finger finger = *fitr;
+                for (int b = Leap::Bone::TYPE_METACARPAL; b <= Leap::Bone::TYPE_DISTAL; ++b) {
+                    const Leap::Bone bone = finger.bone(static_cast<Leap::Bone::Type>(b));
+                    const Leap::Vector prev = bone.prevJoint();
+                    const Leap::Vector next = bone.nextJoint();
+                    const float radius = 0.5f*bone.width();
+                    if (b == Leap::Bone::TYPE_METACARPAL) {
+                        setInstance(index++, osg::Vec3(prev.x, prev.y, prev.z), osg::Vec3(prev.x, prev.y, prev.z), 0.6f*radius, 0.8f);
+                    }
+                    setInstance(index++, osg::Vec3(prev.x, prev.y, prev.z), osg::Vec3(next.x, next.y, next.z), 0.5f*radius, 1.0f);
+                    setInstance(index++, osg::Vec3(next.x, next.y, next.z), osg::Vec3(next.x, next.y, next.z), 0.6f*radius, 0.8f);
+                }
+            }
+#endif
+            hideInstances(index, base+INSTANCES_PER_HAND);
+        }
+        hideInstances(h*INSTANCES_PER_HAND, maxHands_*INSTANCES_PER_HAND);
+
+        // Uploaded in place by the TextureBuffer
+        instanceData_->dirty();
+    }
+
+}
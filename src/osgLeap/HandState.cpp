@@ -10,6 +10,14 @@
 
 #include <osgLeap/HandState>
 
+//-- Project --//
+#include <osgLeap/FlightRecorder>
+#include <osgLeap/HUDCamera>
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/FrameStamp>
+
 //-- OSG: osgDB --//
 #include <osgDB/ReadFile>
 
@@ -27,7 +35,31 @@ namespace osgLeap {
         {
             HandState* hs = dynamic_cast<HandState*>(node);
             if (hs) {
-                hs->update();
+                // Don't pull hands from the frame while nobody sees them,
+                // e.g. if a parent is switched off or masked out by the
+                // camera's cull mask. Culled in the previous frame means
+                // visible. A cached HUD culls its content only when dirty,
+                // so below it the hands have to update to dirty it.
+                const osg::FrameStamp* fs = nv->getFrameStamp();
+                if (fs == NULL || hs->getLastCulledFrame()+2 >= (int)fs->getFrameNumber()
+                    || HUDCamera::hasCachedParent(hs))
+                {
+                    hs->update();
+                }
+            }
+            traverse(node, nv);
+        }
+    };
+
+    // Tells the osgLeap::HandState when it was culled last
+    class HandStateCullCallback: public osg::NodeCallback
+    {
+    public:
+        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            HandState* hs = static_cast<HandState*>(node);
+            if (nv->getFrameStamp() != NULL) {
+                hs->setLastCulledFrame(nv->getFrameStamp()->getFrameNumber());
             }
             traverse(node, nv);
         }
@@ -96,12 +128,13 @@ namespace osgLeap {
     }
 
     HandState::HandState(): osg::Geode(), Leap::Listener(),
-        frame_(Leap::Frame()),
+        lastCulledFrame_(0),
         lhTex_(new osg::Texture2D()),
         rhTex_(new osg::Texture2D())
     {
         // Initialize UpdateCallback to update myself during updateTraversal
         addUpdateCallback(new UpdateCallback());
+        setCullCallback(new HandStateCullCallback());
 
         controller_.addListener(*this);
 
@@ -165,21 +198,28 @@ namespace osgLeap {
 
     HandState::HandState(const HandState& hs,
         const osg::CopyOp& copyOp): osg::Geode(*this), Leap::Listener(*this),
-        frame_(Leap::Frame())
+        lastCulledFrame_(0)
     {
         // ToDo/j.kroeger: Copy texture2d member variables (lhTex_, rhTex_) correctly...
     }
 
     void HandState::onFrame(const Leap::Controller& controller)
     {
-        // Get the most recent frame and store it for later use in update(...)
-        frame_ = controller.frame();
+        OSGLEAP_TRACE_SPAN(span, "HandState::onFrame");
+        // Get the most recent frame and pass it to update(...)
+        const Leap::Frame frame = controller.frame();
+        span.setFrameID(frame.id());
+        FlightRecorder::instance()->recordFrame(frame);
+        frames_.post(frame);
     }
 
     void HandState::update()
     {
+        OSGLEAP_TRACE_SPAN(span, "HandState::update");
         // Grab the frame to work on ...
-        Leap::Frame frame = frame_;
+        const Leap::Frame frame = frames_.fetch();
+        span.setFrameID(frame.id());
+        span.setCounter(0, "hands", frame.hands().count());
 
         // Setup "no-hand" image as default
         osg::Image* lh = sHandsTextures.at(0);
@@ -221,8 +261,12 @@ namespace osgLeap {
             }
         }
 
-        lhTex_->setImage(lh);
-        rhTex_->setImage(rh);
+        if (lhTex_->getImage() != lh || rhTex_->getImage() != rh) {
+            lhTex_->setImage(lh);
+            rhTex_->setImage(rh);
+            // Let a cached HUD know that we look different now
+            HUDCamera::dirtyParents(this);
+        }
     }
 
 }
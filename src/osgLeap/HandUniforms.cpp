@@ -0,0 +1,188 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/HandUniforms>
+
+//-- Project --//
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/Vec2>
+#include <osg/Vec4>
+#include <osg/Viewport>
+
+namespace osgLeap {
+
+    static osg::Vec3 toVec3(const Leap::Vector& v)
+    {
+        return osg::Vec3(v.x, v.y, v.z);
+    }
+
+    HandUniforms::HandUniforms(Space space): osg::NodeCallback(), Leap::Listener(),
+        lastFrameID_(-1),
+        space_(space)
+    {
+        init();
+    }
+
+    HandUniforms::HandUniforms(const HandUniforms& hu,
+        const osg::CopyOp& copyOp): osg::NodeCallback(hu, copyOp), Leap::Listener(),
+        lastFrameID_(-1),
+        space_(hu.space_),
+        sensorToWorld_(hu.sensorToWorld_),
+        camera_(hu.camera_),
+        pointerListener_(hu.pointerListener_)
+    {
+        init();
+    }
+
+    HandUniforms::~HandUniforms()
+    {
+        controller_.removeListener(*this);
+    }
+
+    void HandUniforms::init()
+    {
+        numHands_ = new osg::Uniform("osgLeap_NumHands", 0);
+        palmPositions_ = new osg::Uniform(osg::Uniform::FLOAT_VEC4, "osgLeap_PalmPositions", MAX_HANDS);
+        palmNormals_ = new osg::Uniform(osg::Uniform::FLOAT_VEC3, "osgLeap_PalmNormals", MAX_HANDS);
+        fingerTips_ = new osg::Uniform(osg::Uniform::FLOAT_VEC4, "osgLeap_FingerTips", MAX_HANDS*FINGERS_PER_HAND);
+        numPointers_ = new osg::Uniform("osgLeap_NumPointers", 0);
+        pointerPositions_ = new osg::Uniform(osg::Uniform::FLOAT_VEC2, "osgLeap_PointerPositions", MAX_POINTERS);
+
+        osg::Uniform* uniforms[] = { numHands_.get(), palmPositions_.get(), palmNormals_.get(), fingerTips_.get(), numPointers_.get(), pointerPositions_.get() };
+        for (unsigned int i = 0; i < sizeof(uniforms)/sizeof(uniforms[0]); ++i) {
+            uniforms[i]->setDataVariance(osg::Object::DYNAMIC);
+        }
+        for (unsigned int i = 0; i < MAX_HANDS; ++i) {
+            palmPositions_->setElement(i, osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+            palmNormals_->setElement(i, osg::Vec3(0.0f, -1.0f, 0.0f));
+        }
+        for (unsigned int i = 0; i < MAX_HANDS*FINGERS_PER_HAND; ++i) {
+            fingerTips_->setElement(i, osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+        }
+        for (unsigned int i = 0; i < MAX_POINTERS; ++i) {
+            pointerPositions_->setElement(i, osg::Vec2(0.0f, 0.0f));
+        }
+
+        controller_.addListener(*this);
+    }
+
+    void HandUniforms::addTo(osg::StateSet* stateset) const
+    {
+        if (stateset == NULL) return;
+        stateset->addUniform(numHands_.get());
+        stateset->addUniform(palmPositions_.get());
+        stateset->addUniform(palmNormals_.get());
+        stateset->addUniform(fingerTips_.get());
+        stateset->addUniform(numPointers_.get());
+        stateset->addUniform(pointerPositions_.get());
+    }
+
+    void HandUniforms::onFrame(const Leap::Controller& controller)
+    {
+        // Get the most recent frame and pass it to update()
+        frames_.post(controller.frame());
+    }
+
+    osg::Vec3 HandUniforms::transformPoint(const osg::Vec3& p, const Leap::InteractionBox& box) const
+    {
+        switch (space_) {
+        case WORLD:
+            return p*sensorToWorld_;
+        case SCREEN: {
+            osg::Vec3 result(0.0f, 0.0f, 0.0f);
+            if (box.isValid()) {
+                const Leap::Vector n = box.normalizePoint(Leap::Vector(p.x(), p.y(), p.z()), false);
+                const osg::Viewport* viewport = camera_.valid() ? camera_->getViewport() : NULL;
+                const float width = (viewport != NULL) ? viewport->width() : 1.0f;
+                const float height = (viewport != NULL) ? viewport->height() : 1.0f;
+                result.set(n.x*width, n.y*height, n.z);
+            }
+            return result;
+        }
+        default:
+            return p;
+        }
+    }
+
+    osg::Vec3 HandUniforms::transformNormal(const osg::Vec3& n) const
+    {
+        if (space_ != WORLD) return n;
+        // Normals transform with the inverse transpose
+        osg::Vec3 result = osg::Matrix::transform3x3(osg::Matrix::inverse(sensorToWorld_), n);
+        result.normalize();
+        return result;
+    }
+
+    void HandUniforms::update()
+    {
+        OSGLEAP_TRACE_SPAN(span, "HandUniforms::update");
+        const Leap::Frame frame = frames_.fetch();
+        span.setFrameID(frame.id());
+
+        if (frame.id() != lastFrameID_) {
+            lastFrameID_ = frame.id();
+            const Leap::InteractionBox box = frame.interactionBox();
+            const Leap::HandList hands = frame.hands();
+
+            unsigned int h = 0;
+            for (Leap::HandList::const_iterator itr = hands.begin(); itr != hands.end() && h < MAX_HANDS; ++itr, ++h) {
+                const Leap::Hand hand = *itr;
+                palmPositions_->setElement(h, osg::Vec4(transformPoint(toVec3(hand.palmPosition()), box), 1.0f));
+                palmNormals_->setElement(h, transformNormal(toVec3(hand.palmNormal())));
+
+                const unsigned int base = h*FINGERS_PER_HAND;
+                for (unsigned int f = 0; f < FINGERS_PER_HAND; ++f) {
+                    fingerTips_->setElement(base+f, osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+                }
+                const Leap::FingerList fingers = hand.fingers();
+                unsigned int f = 0;
+                for (Leap::FingerList::const_iterator fitr = fingers.begin(); fitr != fingers.end() && f < FINGERS_PER_HAND; ++fitr, ++f) {
+#ifdef LEAPSDK_1X_COMPATIBILITY
+                    // Visible fingers in no particular order
+                    const unsigned int index = f;
+                    const float extended = 1.0f;
+#else
+                    // Indexed by finger type, thumb first
+                    const unsigned int index = (unsigned int)(*fitr).type() % FINGERS_PER_HAND;
+                    const float extended = (*fitr).isExtended() ? 1.0f : 0.0f;
+#endif
+                    fingerTips_->setElement(base+index, osg::Vec4(transformPoint(toVec3((*fitr).tipPosition()), box), extended));
+                }
+            }
+            numHands_->set((int)h);
+            for (; h < MAX_HANDS; ++h) {
+                palmPositions_->setElement(h, osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+                for (unsigned int f = 0; f < FINGERS_PER_HAND; ++f) {
+                    fingerTips_->setElement(h*FINGERS_PER_HAND+f, osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+                }
+            }
+        }
+
+        int numPointers = 0;
+        osg::ref_ptr<PointerPositionListener> listener;
+        if (pointerListener_.lock(listener)) {
+            const PointerMap& pointers = listener->getPointers();
+            for (PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end() && numPointers < (int)MAX_POINTERS; ++itr, ++numPointers) {
+                pointerPositions_->setElement(numPointers, itr->second->getPosition());
+            }
+        }
+        numPointers_->set(numPointers);
+        span.setCounter(0, "pointers", numPointers);
+    }
+
+    void HandUniforms::operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        update();
+        traverse(node, nv);
+    }
+
+} /* namespace osgLeap */
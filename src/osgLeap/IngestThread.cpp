@@ -0,0 +1,197 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/IngestThread>
+
+//-- Project --//
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/Notify>
+
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+
+//-- STL --//
+#include <cmath>
+
+namespace osgLeap {
+
+    IngestThread::IngestThread(WaitStrategy strategy): osg::Referenced(), OpenThreads::Thread(), Leap::Listener(),
+        strategy_(strategy),
+        spinTime_(1000),
+        requestRedraw_(true),
+        done_(false),
+        lastFrameID_(-1),
+        lastTimestamp_(0),
+        lastArrival_(0)
+    {
+        controller_.addListener(*this);
+    }
+
+    IngestThread::~IngestThread()
+    {
+        controller_.removeListener(*this);
+        cancel();
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(attachMutex_);
+        for (std::vector<Attachment>::iterator itr = attachments_.begin(); itr != attachments_.end(); ++itr) {
+            itr->controller->addListener(*itr->listener);
+        }
+        attachments_.clear();
+    }
+
+    int IngestThread::cancel()
+    {
+        done_ = true;
+        block_.release();
+        if (isRunning()) {
+            join();
+        }
+        done_ = false;
+        return 0;
+    }
+
+    void IngestThread::attach(osg::Referenced* owner, Leap::Listener& listener, Leap::Controller& controller)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(attachMutex_);
+        for (std::vector<Attachment>::const_iterator itr = attachments_.begin(); itr != attachments_.end(); ++itr) {
+            if (itr->listener == &listener) return;
+        }
+        controller.removeListener(listener);
+        Attachment attachment;
+        attachment.owner = owner;
+        attachment.listener = &listener;
+        attachment.controller = &controller;
+        attachments_.push_back(attachment);
+    }
+
+    void IngestThread::detach(Leap::Listener& listener)
+    {
+        // Keep the owner alive until the lock is released
+        osg::ref_ptr<osg::Referenced> owner;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(attachMutex_);
+        for (std::vector<Attachment>::iterator itr = attachments_.begin(); itr != attachments_.end(); ++itr) {
+            if (itr->listener == &listener) {
+                owner = itr->owner;
+                itr->controller->addListener(listener);
+                attachments_.erase(itr);
+                return;
+            }
+        }
+    }
+
+    void IngestThread::setRealtime(bool realtime)
+    {
+        int result = 0;
+        if (realtime) {
+            result |= setSchedulePolicy(OpenThreads::Thread::THREAD_SCHEDULE_FIFO);
+            result |= setSchedulePriority(OpenThreads::Thread::THREAD_PRIORITY_MAX);
+        } else {
+            result |= setSchedulePolicy(OpenThreads::Thread::THREAD_SCHEDULE_DEFAULT);
+            result |= setSchedulePriority(OpenThreads::Thread::THREAD_PRIORITY_DEFAULT);
+        }
+        if (result != 0) {
+            OSG_WARN<<"osgLeap::IngestThread: Could not change the scheduling, call setRealtime before start()."<<std::endl;
+        }
+    }
+
+    IngestThread::Stats IngestThread::getStats() const
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(statsMutex_);
+        return stats_;
+    }
+
+    void IngestThread::resetStats()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(statsMutex_);
+        stats_ = Stats();
+    }
+
+    void IngestThread::onFrame(const Leap::Controller&)
+    {
+        // Only wake up, the frame is taken by the thread
+        block_.release();
+    }
+
+    void IngestThread::waitForFrame(osg::Timer_t lastArrival)
+    {
+        switch (strategy_) {
+        case BUSY_POLL:
+            break;
+        case SPIN_THEN_BLOCK:
+            if (osg::Timer::instance()->delta_u(lastArrival, osg::Timer::instance()->tick()) < spinTime_) {
+                OpenThreads::Thread::YieldCurrentThread();
+                break;
+            }
+            // Fall through
+        case BLOCK:
+            // Re-check after resetting, a frame may have arrived in between
+            block_.reset();
+            {
+                const Leap::Frame frame = controller_.frame();
+                if (!done_ && (!frame.isValid() || frame.id() == lastFrameID_)) block_.block();
+            }
+            break;
+        }
+    }
+
+    void IngestThread::ingest(const Leap::Frame& frame)
+    {
+        OSGLEAP_TRACE_SPAN(span, "IngestThread::ingest");
+        span.setFrameID(frame.id());
+
+        const osg::Timer_t arrival = osg::Timer::instance()->tick();
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(statsMutex_);
+            if (lastFrameID_ >= 0) {
+                if (frame.id() > lastFrameID_ + 1) stats_.numSkipped += (unsigned int)(frame.id() - lastFrameID_ - 1);
+                const double interval = osg::Timer::instance()->delta_m(lastArrival_, arrival);
+                const double expected = (double)(frame.timestamp() - lastTimestamp_)*0.001;
+                const double jitter = fabs(interval - expected);
+                ++stats_.numFrames;
+                stats_.meanJitter += (jitter - stats_.meanJitter)/stats_.numFrames;
+                if (jitter > stats_.maxJitter) stats_.maxJitter = jitter;
+            }
+        }
+        lastFrameID_ = frame.id();
+        lastTimestamp_ = frame.timestamp();
+        lastArrival_ = arrival;
+
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(attachMutex_);
+            for (std::vector<Attachment>::const_iterator itr = attachments_.begin(); itr != attachments_.end(); ++itr) {
+                // Each listener reads the frame from its own controller,
+                // with its own policies and gestures
+                itr->listener->onFrame(*itr->controller);
+            }
+        }
+
+        if (requestRedraw_) {
+            osg::ref_ptr<osgViewer::View> view;
+            if (view_.lock(view)) view->requestRedraw();
+        }
+    }
+
+    void IngestThread::run()
+    {
+        TraceRecorder::instance()->setThreadName("osgLeap::IngestThread");
+
+        while (!done_) {
+            const Leap::Frame frame = controller_.frame();
+            if (!frame.isValid() || frame.id() == lastFrameID_) {
+                waitForFrame(lastArrival_);
+                continue;
+            }
+            ingest(frame);
+        }
+    }
+
+} /* namespace osgLeap */
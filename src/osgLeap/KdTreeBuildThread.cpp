@@ -0,0 +1,154 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/KdTreeBuildThread>
+
+//-- OSG: osg --//
+#include <osg/Geode>
+#include <osg/NodeVisitor>
+
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+
+namespace osgLeap {
+
+    // Collects geometries without a shape (i.e. without KdTree) that are
+    // neither pending nor failed
+    class CollectGeometryVisitor: public osg::NodeVisitor
+    {
+    public:
+        CollectGeometryVisitor(const std::set<osg::Geometry*>& pending, const std::map<osg::Geometry*, osg::observer_ptr<osg::Geometry> >& failed):
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            pending_(pending),
+            failed_(failed)
+        {
+
+        }
+
+        virtual void apply(osg::Geode& geode)
+        {
+            for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+                osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+                if (geom != NULL && geom->getShape() == NULL && pending_.find(geom) == pending_.end()
+                    && failed_.find(geom) == failed_.end())
+                {
+                    geometries.push_back(geom);
+                }
+            }
+            traverse(geode);
+        }
+
+        std::vector<osg::ref_ptr<osg::Geometry> > geometries;
+
+    private:
+        const std::set<osg::Geometry*>& pending_;
+        const std::map<osg::Geometry*, osg::observer_ptr<osg::Geometry> >& failed_;
+    };
+
+    KdTreeBuildThread::KdTreeBuildThread(): osg::Referenced(), OpenThreads::Thread(),
+        done_(false)
+    {
+
+    }
+
+    KdTreeBuildThread::~KdTreeBuildThread()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            done_ = true;
+            condition_.broadcast();
+        }
+        if (isRunning()) {
+            join();
+        }
+    }
+
+    void KdTreeBuildThread::scan(osg::Node* node, osg::Node::NodeMask traversalMask)
+    {
+        if (node == NULL) return;
+
+        // Forget failed geometries that were deleted
+        for (FailedMap::iterator itr = failed_.begin(); itr != failed_.end();) {
+            if (!itr->second.valid()) {
+                failed_.erase(itr++);
+            } else {
+                ++itr;
+            }
+        }
+
+        CollectGeometryVisitor cgv(pending_, failed_);
+        cgv.setTraversalMask(traversalMask);
+        node->accept(cgv);
+        if (cgv.geometries.empty()) return;
+
+        OSG_INFO<<"osgLeap::KdTreeBuildThread: Queueing "<<cgv.geometries.size()<<" geometries."<<std::endl;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            for (unsigned int i = 0; i < cgv.geometries.size(); ++i) {
+                queue_.push_back(cgv.geometries[i]);
+                pending_.insert(cgv.geometries[i].get());
+            }
+            condition_.broadcast();
+        }
+
+        if (!isRunning()) {
+            start();
+        }
+    }
+
+    unsigned int KdTreeBuildThread::apply()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            if (results_.empty()) return 0;
+            applied_.swap(results_);
+        }
+
+        for (std::vector<Result>::iterator itr = applied_.begin(); itr != applied_.end(); ++itr) {
+            // Don't override shapes the application set in the meantime
+            if (!itr->second.valid()) {
+                failed_[itr->first.get()] = itr->first.get();
+            } else if (itr->first->getShape() == NULL) {
+                itr->first->setShape(itr->second.get());
+            }
+            pending_.erase(itr->first.get());
+        }
+        unsigned int num = applied_.size();
+        applied_.clear();
+        return num;
+    }
+
+    void KdTreeBuildThread::run()
+    {
+        while (true) {
+            osg::ref_ptr<osg::Geometry> geom;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+                while (queue_.empty() && !done_) {
+                    condition_.wait(&mutex_);
+                }
+                if (done_) return;
+                geom = queue_.front();
+                queue_.pop_front();
+            }
+
+            // The expensive part runs without holding the lock
+            osg::ref_ptr<osg::KdTree> kdTree = new osg::KdTree();
+            if (!kdTree->build(options_, geom.get())) {
+                // Keep the result anyway, apply() marks the geometry failed
+                kdTree = NULL;
+            }
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            results_.push_back(Result(geom, kdTree));
+        }
+    }
+
+} /* namespace osgLeap */
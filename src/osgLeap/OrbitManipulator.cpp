@@ -12,6 +12,8 @@
 
 //-- Project --//
 #include <osgLeap/Event>
+#include <osgLeap/FlightRecorder>
+#include <osgLeap/TraceRecorder>
 
 //-- OSG: osg --//
 #include <osg/Referenced>
@@ -22,6 +24,12 @@
 
 namespace osgLeap {
 
+    // Palm movement in mm that corresponds to one unit of rotation/zoom
+    static const double REFERENCE_LENGTH = 100.0;
+
+    // Frames to fit palm velocities to, if a FrameHistory is available
+    static const unsigned int VELOCITY_WINDOW = 5;
+
     // Workaround for LeapSDK 0.8.0 or lower which do not include stabilizedPalmPosition
     // ToDo/j.kroeger: Detect version of LeapSDK instead
     Leap::Vector getPalmPosition(const Leap::Hand& hand) {
@@ -39,6 +47,9 @@ namespace osgLeap {
         lastLeftHand_(Leap::Hand()),
         lastRightHand_(Leap::Hand()),
         handsDistance_(0.0f),
+        palmVelocity_(osg::Vec3(0.0f, 0.0f, 0.0f)),
+        handsDistanceVelocity_(0.0),
+        panScale_(1.0),
         currentAction_(LM_None),
 		modifier_(false),
 		modifierKey_(-1),
@@ -60,6 +71,9 @@ namespace osgLeap {
         lastLeftHand_(Leap::Hand()),
         lastRightHand_(Leap::Hand()),
         handsDistance_(0.0f),
+        palmVelocity_(osg::Vec3(0.0f, 0.0f, 0.0f)),
+        handsDistanceVelocity_(0.0),
+        panScale_(1.0),
         currentAction_(LM_None),
 		modifier_(lm.modifier_),
 		modifierKey_(lm.modifierKey_),
@@ -89,6 +103,10 @@ namespace osgLeap {
 			const osgLeap::Event* ev = dynamic_cast<const osgLeap::Event*>(&ea);
 			if (ev != NULL) {
 				const Leap::Frame& frame = ev->getFrame();
+				OSGLEAP_TRACE_SPAN(span, "OrbitManipulator::handle");
+				span.setFrameID(frame.id());
+				span.setCounter(0, "hands", frame.hands().count());
+				int lastAction = currentAction_;
 
 				OSG_DEBUG_FP << "Frame id: " << frame.id()
 					<< ", timestamp: " << frame.timestamp()
@@ -117,7 +135,31 @@ namespace osgLeap {
 							leftHandID_ = handLeft.id();
 						}
 					}
-					double reference_length = 100.0f;
+					double reference_length = REFERENCE_LENGTH;
+
+					// Remember how fast the hands are moving for getPredictedPath
+					// (fit over several frames if the event brings a history,
+					// the velocity of a single frame is rather noisy)
+					const FrameHistory* history = ev->getFrameHistory();
+					palmVelocity_ = osg::Vec3(handRight.palmVelocity().x, handRight.palmVelocity().y, handRight.palmVelocity().z);
+					osg::Vec3 leftVelocity(handLeft.palmVelocity().x, handLeft.palmVelocity().y, handLeft.palmVelocity().z);
+					osg::Vec3 fitted;
+					if (history != NULL && history->getHandMotion(handRight.id(), VELOCITY_WINDOW, fitted)) {
+						palmVelocity_ = fitted;
+					}
+					if (history != NULL && history->getHandMotion(handLeft.id(), VELOCITY_WINDOW, fitted)) {
+						leftVelocity = fitted;
+					}
+					Leap::Vector handsAxis = getPalmPosition(handLeft) - getPalmPosition(handRight);
+					if (handsAxis.magnitude() > 0.0f) {
+						const Leap::Vector axis = handsAxis.normalized();
+						handsDistanceVelocity_ = (leftVelocity-palmVelocity_)*osg::Vec3(axis.x, axis.y, axis.z);
+					} else {
+						handsDistanceVelocity_ = 0.0;
+					}
+					if (us.asView() != NULL) {
+						panScale_ = 2*us.asView()->getCamera()->getBound().radius();
+					}
 
 					if (mode_ == SingleHanded) {
 #ifdef LEAPSDK_1X_COMPATIBILITY
@@ -313,6 +355,12 @@ namespace osgLeap {
 
 				} else {
 					currentAction_ = LM_None;
+					palmVelocity_.set(0.0f, 0.0f, 0.0f);
+					handsDistanceVelocity_ = 0.0;
+				}
+
+				if (currentAction_ != lastAction) {
+					FlightRecorder::instance()->recordAction(frame.id(), currentAction_, palmVelocity_);
 				}
 
 			}
@@ -321,4 +369,77 @@ namespace osgLeap {
         return osgGA::OrbitManipulator::handle(ea, us);
     }
 
+    void OrbitManipulator::getPredictedPath(double horizon, unsigned int steps, std::vector<osg::Matrixd>& path) const
+    {
+        if (currentAction_ == LM_None || steps == 0 || horizon <= 0.0) return;
+
+        // Replay the manipulation on the camera state only, using the
+        // movement the palm will make during each step at its current
+        // velocity
+        PredictedCamera predicted;
+        predicted.center = _center;
+        predicted.rotation = _rotation;
+        predicted.distance = _distance;
+        const double dt = horizon/steps;
+        const osg::Vec3 movement = palmVelocity_*dt;
+        const osg::Vec3 deltaTrans(-movement*panScale_/1000.0f);
+
+        for (unsigned int i = 0; i < steps; ++i) {
+            if (mode_ == SingleHanded) {
+                if (!modifier_) {
+                    predictRotation(predicted, movement.x()/REFERENCE_LENGTH, movement.y()/REFERENCE_LENGTH);
+                    predictZoom(predicted, -movement.z()/REFERENCE_LENGTH);
+                } else {
+                    predictPan(predicted, deltaTrans.x(), deltaTrans.y());
+                }
+            } else if (mode_ == Trackball) {
+                // Rotation follows the hand's orientation which cannot be
+                // extrapolated from the palm velocity, so predict zoom and pan
+                predictZoom(predicted, -movement.z()/REFERENCE_LENGTH);
+                predictPan(predicted, deltaTrans.x(), deltaTrans.y());
+            } else { //TwoHanded
+                if (currentAction_ & LM_Pan) {
+                    predictPan(predicted, deltaTrans.x(), deltaTrans.y());
+                }
+                if (currentAction_ & LM_Zoom) {
+                    double factor = -handsDistanceVelocity_*dt/REFERENCE_LENGTH;
+                    if (factor > 1.0f || factor < -1.0f) { factor = 1.0f; }
+                    predictZoom(predicted, factor);
+                }
+                if (currentAction_ & LM_Rotate) {
+                    predictRotation(predicted, movement.x()/REFERENCE_LENGTH, movement.y()/REFERENCE_LENGTH);
+                }
+            }
+            // Like getMatrix()
+            path.push_back(osg::Matrixd::translate(0.0, 0.0, predicted.distance)*
+                osg::Matrixd::rotate(predicted.rotation)*osg::Matrixd::translate(predicted.center));
+        }
+    }
+
+    void OrbitManipulator::predictRotation(PredictedCamera& camera, float dx, float dy) const
+    {
+        const osg::Vec3d localUp = getUpVector(getCoordinateFrame(camera.center));
+        rotateYawPitch(camera.rotation, dx, dy, localUp);
+    }
+
+    void OrbitManipulator::predictZoom(PredictedCamera& camera, float dy) const
+    {
+        const float scale = 1.0f+dy;
+        float minDist = _minimumDistance;
+        if (getRelativeFlag(_minimumDistanceFlagIndex)) minDist *= _modelSize;
+
+        if (camera.distance*scale > minDist) {
+            camera.distance *= scale;
+        } else {
+            // Push the camera forward, like zoomModel does by default
+            const osg::Vec3d dv = (osg::Vec3d(0.0, 0.0, -1.0)*osg::Matrixd(camera.rotation))*(dy*-camera.distance);
+            camera.center += dv;
+        }
+    }
+
+    void OrbitManipulator::predictPan(PredictedCamera& camera, float dx, float dy) const
+    {
+        camera.center += osg::Vec3d(dx, dy, 0.0)*osg::Matrixd::rotate(camera.rotation);
+    }
+
 }
@@ -0,0 +1,161 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/PagingPrefetcher>
+
+//-- OSG: osg --//
+#include <osg/CullingSet>
+#include <osg/PagedLOD>
+
+//-- STL --//
+#include <cmath>
+
+namespace osgLeap {
+
+    // Walks the PagedLOD hierarchy as seen from one predicted camera and
+    // requests the next child of PagedLODs that need more than they have
+    // loaded, like osg::PagedLOD::traverse would from there
+    class PrefetchVisitor: public osg::NodeVisitor
+    {
+    public:
+        PrefetchVisitor(osg::NodeVisitor::DatabaseRequestHandler* handler, const osg::FrameStamp* frameStamp,
+            const osg::Matrixd& viewMatrix, const osg::Matrixd& projectionMatrix, const osg::Viewport* viewport,
+            float priority): osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
+            handler_(handler), frameStamp_(frameStamp), viewMatrix_(viewMatrix),
+            projectionMatrix_(projectionMatrix), viewport_(viewport), priority_(priority), numRequests_(0)
+        {
+
+        }
+
+        virtual void apply(osg::LOD& lod)
+        {
+            // Plain LODs hold all their children in memory. Descend into
+            // all of them to find PagedLODs below.
+            traverse(lod);
+        }
+
+        virtual void apply(osg::PagedLOD& plod)
+        {
+            osg::Matrixd localToWorld = osg::computeLocalToWorld(getNodePath());
+            osg::Vec3 center = plod.getCenter();
+
+            float required;
+            if (plod.getRangeMode() == osg::LOD::DISTANCE_FROM_EYE_POINT) {
+                osg::Vec3 eye = osg::Matrixd::inverse(localToWorld*viewMatrix_).getTrans();
+                required = (center-eye).length();
+            } else {
+                if (viewport_ == NULL) {
+                    traverse(plod);
+                    return;
+                }
+                osg::Vec4 psv = osg::CullingSet::computePixelSizeVector(*viewport_, projectionMatrix_, localToWorld*viewMatrix_);
+                float distance = center*osg::Vec3(psv.x(), psv.y(), psv.z())+psv.w();
+                required = (distance != 0.0f) ? fabs(plod.getRadius()/distance) : 0.0f;
+            }
+
+            const unsigned int numChildren = plod.getNumChildren();
+            const osg::LOD::RangeList& ranges = plod.getRangeList();
+            bool needsMore = false;
+            bool lastTraversed = false;
+            for (unsigned int i = 0; i < ranges.size(); ++i) {
+                if (required < ranges[i].first || required >= ranges[i].second) continue;
+
+                if (i < numChildren) {
+                    // Already loaded, look for PagedLODs further down
+                    plod.getChild(i)->accept(*this);
+                    if (i+1 == numChildren) lastTraversed = true;
+                } else {
+                    needsMore = true;
+                }
+            }
+            if (!needsMore) return;
+
+            // Meanwhile the last loaded child is drawn
+            if (numChildren > 0 && !lastTraversed) plod.getChild(numChildren-1)->accept(*this);
+
+            // The DatabasePager appends every loaded model as the next
+            // child, so only that one may be requested. A deeper level
+            // finishing first would end up at the wrong index.
+            if (numChildren < plod.getNumFileNames() && !plod.getFileName(numChildren).empty()) {
+                float priority = plod.getPriorityOffset(numChildren)+plod.getPriorityScale(numChildren)*priority_;
+                osg::NodePath nodePath = getNodePath();
+                handler_->requestNodeFile(plod.getDatabasePath()+plod.getFileName(numChildren), nodePath,
+                    priority, frameStamp_, plod.getDatabaseRequest(numChildren), plod.getDatabaseOptions());
+                ++numRequests_;
+            }
+        }
+
+        unsigned int getNumRequests() const { return numRequests_; }
+
+    private:
+        osg::NodeVisitor::DatabaseRequestHandler* handler_;
+        const osg::FrameStamp* frameStamp_;
+        osg::Matrixd viewMatrix_;
+        osg::Matrixd projectionMatrix_;
+        const osg::Viewport* viewport_;
+        float priority_;
+        unsigned int numRequests_;
+    };
+
+    PagingPrefetcher::PagingPrefetcher(osgLeap::OrbitManipulator* manipulator, osg::Camera* camera): osg::NodeCallback(),
+        manipulator_(manipulator),
+        camera_(camera),
+        handler_(NULL),
+        horizon_(0.3),
+        steps_(3),
+        priority_(-1.0f),
+        numRequests_(0)
+    {
+
+    }
+
+    PagingPrefetcher::PagingPrefetcher(const PagingPrefetcher& pp, const osg::CopyOp& op): osg::NodeCallback(pp, op),
+        manipulator_(pp.manipulator_),
+        camera_(pp.camera_),
+        handler_(pp.handler_),
+        horizon_(pp.horizon_),
+        steps_(pp.steps_),
+        priority_(pp.priority_),
+        numRequests_(0)
+    {
+
+    }
+
+    void PagingPrefetcher::operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        osg::NodeVisitor::DatabaseRequestHandler* handler = handler_.valid() ? handler_.get() : nv->getDatabaseRequestHandler();
+        if (handler != NULL) {
+            prefetch(node, handler, nv->getFrameStamp());
+        }
+
+        traverse(node, nv);
+    }
+
+    void PagingPrefetcher::prefetch(osg::Node* node, osg::NodeVisitor::DatabaseRequestHandler* handler, const osg::FrameStamp* frameStamp)
+    {
+        osg::ref_ptr<osgLeap::OrbitManipulator> manipulator;
+        osg::ref_ptr<osg::Camera> camera;
+        if (!manipulator_.lock(manipulator) || !camera_.lock(camera) || handler == NULL) return;
+
+        path_.clear();
+        manipulator->getPredictedPath(horizon_, steps_, path_);
+
+        for (unsigned int i = 0; i < path_.size(); ++i) {
+            // Requests further ahead are less urgent
+            float priority = priority_*(1.0f+(float)i/path_.size());
+            PrefetchVisitor pv(handler, frameStamp, osg::Matrixd::inverse(path_[i]), camera->getProjectionMatrix(),
+                camera->getViewport(), priority);
+            pv.setTraversalMask(camera->getCullMask());
+            node->accept(pv);
+            numRequests_ += pv.getNumRequests();
+        }
+    }
+
+} // namespace osgLeap
@@ -0,0 +1,287 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/PickThread>
+
+//-- OSG: osg --//
+#include <osg/Camera>
+#include <osg/Geode>
+#include <osg/NodeVisitor>
+#include <osg/Transform>
+#include <osg/TriangleFunctor>
+#include <osg/Version>
+
+//-- STL --//
+#include <algorithm>
+#include <cmath>
+
+namespace osgLeap {
+
+    namespace {
+
+        // Collects the geometries with their accumulated world matrices
+        class SnapshotVisitor: public osg::NodeVisitor {
+        public:
+            SnapshotVisitor(std::vector<PickSnapshot::Entry>& entries):
+                osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN), entries_(entries) {}
+
+            virtual void apply(osg::Transform& transform)
+            {
+                osg::Camera* camera = dynamic_cast<osg::Camera*>(&transform);
+                if (camera != NULL && camera->getReferenceFrame() != osg::Transform::RELATIVE_RF) return;
+
+                const osg::Matrixd parentMatrix = matrix_;
+                transform.computeLocalToWorldMatrix(matrix_, this);
+                traverse(transform);
+                matrix_ = parentMatrix;
+            }
+
+            virtual void apply(osg::Geode& geode)
+            {
+                for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+                    osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+                    if (geometry == NULL) continue;
+
+                    PickSnapshot::Entry entry;
+                    entry.geometry = geometry;
+                    entry.inverseMatrix.invert(matrix_);
+                    // The cached bound, computed here if dirty rather than
+                    // on the worker
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 3, 2)
+                    entry.bound = geometry->getBoundingBox();
+#else
+                    entry.bound = geometry->getBound();
+#endif
+                    // KdTreeBuildThread sets shapes on this thread, so the
+                    // worker must not look at them
+                    entry.kdTree = dynamic_cast<const osg::KdTree*>(geometry->getShape());
+                    entries_.push_back(entry);
+                }
+            }
+
+        private:
+            std::vector<PickSnapshot::Entry>& entries_;
+            osg::Matrixd matrix_;
+        };
+
+        // Whether the segment from start along direction (t in [0, 1])
+        // crosses the box
+        bool segmentHitsBox(const osg::BoundingBox& bb, const osg::Vec3d& start, const osg::Vec3d& direction)
+        {
+            if (!bb.valid()) return false;
+            double tmin = 0.0;
+            double tmax = 1.0;
+            for (int i = 0; i < 3; ++i) {
+                if (direction[i] == 0.0) {
+                    if (start[i] < bb._min[i] || start[i] > bb._max[i]) return false;
+                    continue;
+                }
+                double t0 = (bb._min[i]-start[i])/direction[i];
+                double t1 = (bb._max[i]-start[i])/direction[i];
+                if (t0 > t1) std::swap(t0, t1);
+                tmin = std::max(tmin, t0);
+                tmax = std::min(tmax, t1);
+                if (tmin > tmax) return false;
+            }
+            return true;
+        }
+
+        // Segment-triangle test (Moeller-Trumbore), for osg::TriangleFunctor
+        struct SegmentTriangle {
+            SegmentTriangle(): hit(false) {}
+
+            void operator()(const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3)
+            {
+                if (hit) return;
+                const osg::Vec3d e1 = osg::Vec3d(v2)-osg::Vec3d(v1);
+                const osg::Vec3d e2 = osg::Vec3d(v3)-osg::Vec3d(v1);
+                const osg::Vec3d p = direction^e2;
+                const double det = e1*p;
+                if (fabs(det) < 1e-12) return;
+
+                const osg::Vec3d s = start-osg::Vec3d(v1);
+                const double u = (s*p)/det;
+                if (u < 0.0 || u > 1.0) return;
+                const osg::Vec3d q = s^e1;
+                const double v = (direction*q)/det;
+                if (v < 0.0 || u+v > 1.0) return;
+                const double t = (e2*q)/det;
+                hit = (t >= 0.0 && t <= 1.0);
+            }
+
+            // Older OSG versions pass treatVertexDataAsTemporary
+            void operator()(const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3, bool)
+            {
+                (*this)(v1, v2, v3);
+            }
+
+            osg::Vec3d start;
+            osg::Vec3d direction;
+            bool hit;
+        };
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 3, 2)
+        // Visitor of osg::KdTree::intersect, testing the triangles of the
+        // leaves the segment passes through
+        struct KdTreeSegment {
+            KdTreeSegment(const osg::Vec3d& start, const osg::Vec3d& direction)
+            {
+                triangle.start = start;
+                triangle.direction = direction;
+            }
+
+            bool enter(const osg::BoundingBox& bb) { return !triangle.hit && segmentHitsBox(bb, triangle.start, triangle.direction); }
+            void leave() {}
+
+            // Points and lines cannot be hit
+            template<class Vertices>
+            void intersect(const Vertices*, int, unsigned int) {}
+            template<class Vertices>
+            void intersect(const Vertices*, int, unsigned int, unsigned int) {}
+
+            template<class Vertices>
+            void intersect(const Vertices* vertices, int, unsigned int p0, unsigned int p1, unsigned int p2)
+            {
+                triangle((*vertices)[p0], (*vertices)[p1], (*vertices)[p2]);
+            }
+
+            template<class Vertices>
+            void intersect(const Vertices* vertices, int, unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
+            {
+                triangle((*vertices)[p0], (*vertices)[p1], (*vertices)[p3]);
+                triangle((*vertices)[p1], (*vertices)[p2], (*vertices)[p3]);
+            }
+
+            SegmentTriangle triangle;
+        };
+#endif
+
+        bool intersectKdTree(const osg::KdTree& kdTree, const osg::Vec3d& start, const osg::Vec3d& direction)
+        {
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 3, 2)
+            if (kdTree.getNodes().empty()) return false;
+            KdTreeSegment functor(start, direction);
+            kdTree.intersect(functor, kdTree.getNode(0));
+            return functor.triangle.hit;
+#else
+            osg::KdTree::LineSegmentIntersections intersections;
+            return kdTree.intersect(start, start+direction, intersections);
+#endif
+        }
+
+    }
+
+    PickSnapshot::PickSnapshot(osg::Node* scene, osg::Node::NodeMask traversalMask): osg::Referenced()
+    {
+        if (scene == NULL) return;
+        SnapshotVisitor visitor(entries_);
+        visitor.setTraversalMask(traversalMask);
+        scene->accept(visitor);
+    }
+
+    bool PickSnapshot::intersects(const osg::Vec3d& start, const osg::Vec3d& end) const
+    {
+        for (std::vector<Entry>::const_iterator itr = entries_.begin(); itr != entries_.end(); ++itr) {
+            osg::TriangleFunctor<SegmentTriangle> functor;
+            functor.start = start*itr->inverseMatrix;
+            functor.direction = end*itr->inverseMatrix-functor.start;
+            if (!segmentHitsBox(itr->bound, functor.start, functor.direction)) continue;
+
+            if (itr->kdTree.valid()) {
+                if (intersectKdTree(*itr->kdTree, functor.start, functor.direction)) return true;
+                continue;
+            }
+            // Without a tree (yet), triangle by triangle
+            itr->geometry->accept(functor);
+            if (functor.hit) return true;
+        }
+        return false;
+    }
+
+    PickThread::PickThread(unsigned int queueSize): osg::Referenced(), OpenThreads::Thread(),
+        requests_(queueSize),
+        results_(queueSize),
+        done_(false)
+    {
+
+    }
+
+    PickThread::~PickThread()
+    {
+        cancel();
+    }
+
+    int PickThread::cancel()
+    {
+        done_ = true;
+        block_.release();
+        if (isRunning()) {
+            join();
+        }
+        return 0;
+    }
+
+    bool PickThread::post(const Request& request)
+    {
+        if (!requests_.push(request)) return false;
+        block_.release();
+
+        if (!isRunning()) {
+            start();
+        }
+        return true;
+    }
+
+    bool PickThread::poll(Result& result)
+    {
+        return results_.pop(result);
+    }
+
+    void PickThread::run()
+    {
+        Request request;
+        while (!done_) {
+            if (!requests_.pop(request)) {
+                // Re-check after resetting, a request may have arrived in
+                // between
+                block_.reset();
+                if (requests_.empty() && !done_) block_.block();
+                continue;
+            }
+            if (!request.snapshot.valid()) continue;
+
+            // Ray through the pointer from the near to the far plane in
+            // world coordinates, cf. osg::Viewport::computeWindowMatrix
+            const osg::Vec4d& vp = request.viewport;
+            const osg::Matrixd windowMatrix = osg::Matrixd::translate(1.0, 1.0, 1.0)*osg::Matrixd::scale(0.5*vp[2], 0.5*vp[3], 0.5)
+                *osg::Matrixd::translate(vp[0], vp[1], 0.0);
+            osg::Matrixd inverse;
+            inverse.invert(request.viewMatrix*request.projectionMatrix*windowMatrix);
+            osg::Vec3d start = osg::Vec3d(request.position.x(), request.position.y(), 0.0)*inverse;
+            osg::Vec3d end = osg::Vec3d(request.position.x(), request.position.y(), 1.0)*inverse;
+
+            Result result;
+            result.pointableID = request.pointableID;
+            result.position = request.position;
+            result.viewMatrix = request.viewMatrix;
+            result.projectionMatrix = request.projectionMatrix;
+            result.viewport = request.viewport;
+            result.frameNumber = request.frameNumber;
+            result.hit = request.snapshot->intersects(start, end);
+            // Release the snapshot before the next wait
+            request = Request();
+
+            // The device drains results every frame, so a full queue
+            // means nobody is interested anymore
+            results_.push(result);
+        }
+    }
+
+} /* namespace osgLeap */
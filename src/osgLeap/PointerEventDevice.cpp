@@ -10,6 +10,10 @@
 
 #include <osgLeap/PointerEventDevice>
 
+//-- Project --//
+#include <osgLeap/FlightRecorder>
+#include <osgLeap/TraceRecorder>
+
 //-- OSG: osg --//
 #include <osg/io_utils>
 
@@ -19,6 +23,10 @@
 //-- OSG: osgGA --//
 #include <osgGA/GUIEventAdapter>
 
+//-- STL --//
+#include <algorithm>
+#include <cmath>
+
 namespace osgLeap {
 
     bool PointerEventDevice::checkEvents()
@@ -35,6 +43,11 @@ namespace osgLeap {
 
     bool PointerEventDevice::hasIntersections(osgLeap::Pointer* p) {
         bool hasIntersections = false;
+        if (asyncPicking_) {
+            // Only look at what the worker has found so far
+            std::map<int, PickThread::Result>::const_iterator itr = pickResults_.find(p->getPointableID());
+            return (itr != pickResults_.end() && itr->second.hit && !isStale(itr->second, p));
+        }
         if (getTraversalMask() != 0 && getView() != NULL) {
             osgUtil::LineSegmentIntersector::Intersections intersections;
             if (getView()->computeIntersections(getView()->getCamera(), osgUtil::Intersector::VIEW, p->getPosition().x(), p->getPosition().y(), intersections, getTraversalMask())) {
@@ -47,9 +60,112 @@ namespace osgLeap {
         return hasIntersections;
     }
 
+    bool PointerEventDevice::hitsTarget(osgLeap::Pointer* p)
+    {
+        if (!targetIndex_.valid() || getTraversalMask() == 0) return false;
+        return targetIndex_->pick(p->getPosition().x(), p->getPosition().y(), getTraversalMask()) != NULL;
+    }
+
     bool PointerEventDevice::allowedToClick(osgLeap::Pointer* p)
     {
-        return (getView() == NULL || getTraversalMask() == 0 || hasIntersections(p));
+        if (getTraversalMask() == 0 || (getView() == NULL && !targetIndex_.valid())) return true;
+        // 2D targets are a constant time lookup, so check them first
+        return (hitsTarget(p) || hasIntersections(p));
+    }
+
+    void PointerEventDevice::setAsyncPicking(bool enabled)
+    {
+        asyncPicking_ = enabled;
+        if (!enabled) {
+            pickThread_ = NULL;
+            pickSnapshot_ = NULL;
+            pickScan_ = SceneScan();
+            pickResults_.clear();
+        }
+    }
+
+    void PointerEventDevice::postPick(osgLeap::Pointer* p)
+    {
+        osg::Camera* camera = getView()->getCamera();
+        const osg::Viewport* viewport = camera->getViewport();
+        if (viewport == NULL || !pickSnapshot_.valid()) return;
+
+        PickThread::Request request;
+        request.pointableID = p->getPointableID();
+        request.position = p->getPosition();
+        request.viewMatrix = camera->getViewMatrix();
+        request.projectionMatrix = camera->getProjectionMatrix();
+        request.viewport.set(viewport->x(), viewport->y(), viewport->width(), viewport->height());
+        request.snapshot = pickSnapshot_;
+        request.frameNumber = getView()->getFrameStamp() != NULL ? getView()->getFrameStamp()->getFrameNumber() : 0;
+
+        if (!pickThread_.valid()) pickThread_ = new PickThread();
+        // If the worker has fallen behind, the pointer is picked next frame
+        pickThread_->post(request);
+    }
+
+    void PointerEventDevice::collectPicks()
+    {
+        if (!pickThread_.valid()) return;
+
+        PickThread::Result result;
+        while (pickThread_->poll(result)) {
+            std::map<int, PickThread::Result>::iterator itr = pickResults_.find(result.pointableID);
+            if (itr == pickResults_.end()) {
+                pickResults_.insert(std::pair<int, PickThread::Result>(result.pointableID, result));
+            } else if (result.frameNumber >= itr->second.frameNumber) {
+                itr->second = result;
+            }
+        }
+    }
+
+    bool PointerEventDevice::isStale(const PickThread::Result& result, osgLeap::Pointer* p) const
+    {
+        if (view_ == NULL) return true;
+        unsigned int frameNumber = (view_->getFrameStamp() != NULL) ? view_->getFrameStamp()->getFrameNumber() : 0;
+        if (frameNumber > result.frameNumber+maxPickAge_) return true;
+        if ((p->getPosition()-result.position).length() > p->getDeltaMax()) return true;
+
+        const osg::Camera* camera = view_->getCamera();
+        const osg::Matrixd& viewMatrix = camera->getViewMatrix();
+        const osg::Matrixd& projectionMatrix = camera->getProjectionMatrix();
+        for (int i = 0; i < 16; ++i) {
+            if (fabs(viewMatrix.ptr()[i]-result.viewMatrix.ptr()[i]) > viewTolerance_) return true;
+            if (fabs(projectionMatrix.ptr()[i]-result.projectionMatrix.ptr()[i]) > viewTolerance_) return true;
+        }
+
+        const osg::Viewport* viewport = camera->getViewport();
+        return (viewport == NULL || osg::Vec4d(viewport->x(), viewport->y(), viewport->width(), viewport->height()) != result.viewport);
+    }
+
+    unsigned int PointerEventDevice::getHoveredTarget(int pointableID) const
+    {
+        std::map<int, unsigned int>::const_iterator itr = hoveredTargets_.find(pointableID);
+        return (itr != hoveredTargets_.end()) ? itr->second : 0;
+    }
+
+    void PointerEventDevice::updateHoveredTarget(osgLeap::Pointer* p, bool removed)
+    {
+        unsigned int target = 0;
+        if (!removed) {
+            const TargetIndex::Target* t = targetIndex_->pick(p->getPosition().x(), p->getPosition().y(), getTraversalMask() != 0 ? getTraversalMask() : 0xffffffff);
+            if (t != NULL) target = t->id;
+        }
+
+        std::map<int, unsigned int>::iterator itr = hoveredTargets_.find(p->getPointableID());
+        unsigned int last = (itr != hoveredTargets_.end()) ? itr->second : 0;
+        if (target == last) return;
+
+        if (last != 0 && targetCallback_.valid()) targetCallback_->leave(p, last);
+        if (target != 0 && targetCallback_.valid()) targetCallback_->enter(p, target);
+
+        if (target == 0) {
+            hoveredTargets_.erase(itr);
+        } else if (itr != hoveredTargets_.end()) {
+            itr->second = target;
+        } else {
+            hoveredTargets_.insert(std::pair<int, unsigned int>(p->getPointableID(), target));
+        }
     }
 
     osg::ref_ptr<osgGA::GUIEventAdapter> PointerEventDevice::makeMouseEvent(osgLeap::Pointer* p)
@@ -114,111 +230,250 @@ namespace osgLeap {
         return e;
     }
 
-    osgGA::GUIEventAdapter* PointerEventDevice::touchMoved(osgLeap::Pointer* p)
+    osgGA::GUIEventAdapter* PointerEventDevice::touchEnded(osgLeap::Pointer* p, unsigned int taps)
     {
 #ifdef _DEBUG
-        OSG_NOTICE<<"touchMoved: "<<p->getPosition()<<std::endl;
+        OSG_NOTICE<<"touchEnded: "<<p->getPointableID()<<std::endl;
 #endif
         osg::Vec2 pos = p->getRelativePositionInScreenCoordinates();
-        osgGA::GUIEventAdapter* e = _eventQueue->touchMoved(p->getPointableID(), osgGA::GUIEventAdapter::TOUCH_MOVED, pos.x(), pos.y());
+        osgGA::GUIEventAdapter* e = _eventQueue->touchEnded(p->getPointableID(), osgGA::GUIEventAdapter::TOUCH_ENDED, pos.x(), pos.y(), taps);
         e->setWindowWidth(p->getResolution().x());
         e->setWindowHeight(p->getResolution().y());
         return e;
     }
 
-    osgGA::GUIEventAdapter* PointerEventDevice::touchEnded(osgLeap::Pointer* p, unsigned int taps)
+    osgGA::GUIEventAdapter* PointerEventDevice::touchFrame(const PointerMap& pointers, const PointerMap& removedPointers)
     {
+        // The event type follows the OSG convention: PUSH if any point
+        // began, RELEASE if all points ended and DRAG otherwise. The first
+        // point is chosen to match, as the event queue derives the type and
+        // the emulated mouse state from it.
+        osgLeap::Pointer* first = NULL;
+        osgGA::GUIEventAdapter::TouchPhase firstPhase = osgGA::GUIEventAdapter::TOUCH_ENDED;
+        for (PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+            if (itr->second->isNew()) {
+                first = itr->second.get();
+                firstPhase = osgGA::GUIEventAdapter::TOUCH_BEGAN;
+                break;
+            }
+            if (first == NULL) {
+                first = itr->second.get();
+                firstPhase = itr->second->hasMoved() ? osgGA::GUIEventAdapter::TOUCH_MOVED : osgGA::GUIEventAdapter::TOUCH_STATIONERY;
+            }
+        }
+        if (first == NULL) {
+            if (removedPointers.empty()) return NULL;
+            first = removedPointers.begin()->second.get();
+        }
+
 #ifdef _DEBUG
-        OSG_NOTICE<<"touchEnded: "<<p->getPointableID()<<std::endl;
+        OSG_NOTICE<<"touchFrame: "<<pointers.size()<<" points, "<<removedPointers.size()<<" ended"<<std::endl;
 #endif
-        osg::Vec2 pos = p->getRelativePositionInScreenCoordinates();
-        osgGA::GUIEventAdapter* e = _eventQueue->touchEnded(p->getPointableID(), osgGA::GUIEventAdapter::TOUCH_ENDED, pos.x(), pos.y(), taps);
-        e->setWindowWidth(p->getResolution().x());
-        e->setWindowHeight(p->getResolution().y());
+        osg::Vec2 pos = first->getRelativePositionInScreenCoordinates();
+        osgGA::GUIEventAdapter* e = NULL;
+        if (firstPhase == osgGA::GUIEventAdapter::TOUCH_BEGAN) {
+            e = _eventQueue->touchBegan(first->getPointableID(), firstPhase, pos.x(), pos.y());
+        } else if (firstPhase == osgGA::GUIEventAdapter::TOUCH_ENDED) {
+            e = _eventQueue->touchEnded(first->getPointableID(), firstPhase, pos.x(), pos.y(), 0);
+        } else {
+            e = _eventQueue->touchMoved(first->getPointableID(), firstPhase, pos.x(), pos.y());
+        }
+        e->setWindowWidth(first->getResolution().x());
+        e->setWindowHeight(first->getResolution().y());
+
+        for (PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+            if (itr->second.get() == first) continue;
+            osgGA::GUIEventAdapter::TouchPhase phase = osgGA::GUIEventAdapter::TOUCH_STATIONERY;
+            if (itr->second->isNew()) {
+                phase = osgGA::GUIEventAdapter::TOUCH_BEGAN;
+            } else if (itr->second->hasMoved()) {
+                phase = osgGA::GUIEventAdapter::TOUCH_MOVED;
+            }
+            pos = itr->second->getRelativePositionInScreenCoordinates();
+            e->addTouchPoint(itr->first, phase, pos.x(), pos.y());
+        }
+        for (PointerMap::const_iterator itr = removedPointers.begin(); itr != removedPointers.end(); ++itr) {
+            if (itr->second.get() == first) continue;
+            pos = itr->second->getRelativePositionInScreenCoordinates();
+            e->addTouchPoint(itr->first, osgGA::GUIEventAdapter::TOUCH_ENDED, pos.x(), pos.y());
+        }
         return e;
     }
 
-    osgGA::GUIEventAdapter* PointerEventDevice::touchStationary(osgLeap::Pointer* p)
+
+    void PointerEventDevice::requireFeatures()
     {
-        osg::Vec2 pos = p->getRelativePositionInScreenCoordinates();
-        osgGA::GUIEventAdapter* e = _eventQueue->touchMoved(p->getPointableID(), osgGA::GUIEventAdapter::TOUCH_STATIONERY, pos.x(), pos.y());
-        e->setWindowWidth(p->getResolution().x());
-        e->setWindowHeight(p->getResolution().y());
-        return e;
+        if (!intersectionController_.valid()) return;
+
+        unsigned int features = Listener::FEATURE_POINTABLES | Listener::FEATURE_SCREEN_INTERSECTIONS;
+        if (clickMode_ == SCREENTAP) {
+            features |= Listener::FEATURE_GESTURE_SCREEN_TAP;
+        } else if (clickMode_ == TIMEBASED_MOUSECLICK) {
+            intersectionController_->getDwellEngine()->setDwellTime(referenceTime_);
+        }
+        intersectionController_->requireFeatures(this, features);
     }
 
+    void PointerEventDevice::updateKdTrees()
+    {
+        if (!buildKdTrees_ || getView() == NULL || getTraversalMask() == 0) return;
+
+        osg::Node* scene = getView()->getSceneData();
+        if (scene != NULL && kdTreeScan_.update(scene, getTraversalMask(), rescanInterval_)) {
+            if (!kdTreeBuilder_.valid()) kdTreeBuilder_ = new KdTreeBuildThread();
+            // Only geometries without a tree are queued
+            kdTreeBuilder_->scan(scene, getTraversalMask());
+        }
+
+        // New trees are picked up by the next pick snapshot
+        if (kdTreeBuilder_.valid() && kdTreeBuilder_->apply() > 0) pickScan_.stale = true;
+    }
+
+    void PointerEventDevice::updatePickSnapshot()
+    {
+        osg::Node* scene = getView()->getSceneData();
+        if (scene == NULL) {
+            pickSnapshot_ = NULL;
+            pickScan_ = SceneScan();
+            return;
+        }
+        // Pending requests keep the previous snapshot
+        if (pickScan_.update(scene, getTraversalMask(), rescanInterval_) || !pickSnapshot_.valid()) {
+            pickSnapshot_ = new PickSnapshot(scene, getTraversalMask());
+        }
+    }
+
+    bool PointerEventDevice::SceneScan::update(const osg::Node* node, osg::Node::NodeMask traversalMask, double interval)
+    {
+        const osg::BoundingSphere& bs = node->getBound();
+        const osg::Timer_t now = osg::Timer::instance()->tick();
+        // A changing bound hints at new (e.g. paged) geometries, but may
+        // change every frame while something moves
+        const bool boundChanged = (bs.center() != bound.center() || bs.radius() != bound.radius());
+        const bool due = (boundChanged || stale) && osg::Timer::instance()->delta_s(tick, now) >= interval;
+        if (!dirty && node == scene && traversalMask == mask && !due) return false;
+
+        scene = node;
+        bound = bs;
+        mask = traversalMask;
+        dirty = false;
+        stale = false;
+        tick = now;
+        return true;
+    }
+
+    void PointerEventDevice::collectScreenTaps()
+    {
+        // Walk the gestures once per frame instead of once per pointer
+        tappedIDs_.clear();
+        const Leap::GestureList& gestures = intersectionController_->getGestures();
+        for (Leap::GestureList::const_iterator gtr = gestures.begin(); gtr != gestures.end(); ++gtr) {
+            if ((*gtr).type() != Leap::Gesture::TYPE_SCREEN_TAP) continue;
+#ifdef LEAPSDK_1X_COMPATIBILITY
+            Leap::PointableList pointables = (*gtr).pointables();
+#else
+            Leap::PointableList pointables = (*gtr).pointables().extended();
+#endif
+            for (Leap::PointableList::const_iterator ptr = pointables.begin(); ptr != pointables.end(); ++ptr) {
+                tappedIDs_.push_back((*ptr).id());
+            }
+        }
+        std::sort(tappedIDs_.begin(), tappedIDs_.end());
+    }
 
     void PointerEventDevice::update()
     {
+        OSGLEAP_TRACE_SPAN(span, "PointerEventDevice::update");
+        unsigned int numEvents = 0;
+
+        updateKdTrees();
         intersectionController_->update();
+        span.setFrameID(intersectionController_->getLastFrame().id());
 
-        PointerMap removedPointers = intersectionController_->getRemovedPointers();
-        if (emulationMode_ == TOUCH) {
-            for (PointerMap::iterator itr = removedPointers.begin(); itr != removedPointers.end(); ++itr) {
-                touchEnded(itr->second, 0);
+        bool picking = asyncPicking_ && clickMode_ != NONE && getTraversalMask() != 0 && getView() != NULL;
+        if (picking) {
+            collectPicks();
+            updatePickSnapshot();
+        }
+
+        const PointerMap& removedPointers = intersectionController_->getRemovedPointers();
+        if (asyncPicking_) {
+            for (PointerMap::const_iterator itr = removedPointers.begin(); itr != removedPointers.end(); ++itr) {
+                pickResults_.erase(itr->first);
+            }
+        }
+        if (targetIndex_.valid()) {
+            for (PointerMap::const_iterator itr = removedPointers.begin(); itr != removedPointers.end(); ++itr) {
+                updateHoveredTarget(itr->second, true);
             }
         }
 
-        PointerMap pointers = intersectionController_->getPointers();
-        for (PointerMap::iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+        if (clickMode_ == SCREENTAP) collectScreenTaps();
+        osg::Vec3 normal(0.0f, 0.0f, 1.0f);
+        if (clickMode_ == VELOCITY_TAP && intersectionController_->getScreenModel() != NULL) {
+            normal = intersectionController_->getScreenModel()->getNormal();
+        }
+
+        const PointerMap& pointers = intersectionController_->getPointers();
+        if (emulationMode_ == TOUCH) {
+            // One event holding all touch points of this frame
+            if (touchFrame(pointers, removedPointers) != NULL) ++numEvents;
+        }
+
+        for (PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+            if (targetIndex_.valid()) {
+                // Targets may move below a resting pointer, so look up
+                // every frame. It's cheap.
+                updateHoveredTarget(itr->second, false);
+            }
+
             if (emulationMode_ == MOUSE) {
                 if (itr->second->hasMoved()) {
                     mouseMotion(itr->second);
+                    ++numEvents;
                 }
-            } else if (emulationMode_ == TOUCH) {
-                if (itr->second->isNew()) {
-                    touchBegan(itr->second);
-                } else if (itr->second->hasMoved()) {
-                    touchMoved(itr->second);
-                } else {
-                    touchStationary(itr->second);
-                }
+            }
+
+            // Results arrive in a later frame and gate the click then
+            if (picking && !hitsTarget(itr->second)) {
+                postPick(itr->second);
             }
 
             bool doClick = false;
             if (clickMode_ == TIMEBASED_MOUSECLICK) {
-                if (allowedToClick(itr->second)) {
-                    // ToDo/j.kroeger: Set time to zero as long as there is no appropriate intersection
-                    if (itr->second->clickTimeHasElapsed(referenceTime_)) doClick = true;
-                }
+                // Take the click in any case, so it does not fire later
+                // when the pointer moves onto a valid target
+                if (itr->second->takeDwellClick() && allowedToClick(itr->second)) doClick = true;
             } else if (clickMode_ == SCREENTAP) {
-                for (Leap::GestureList::const_iterator gtr = intersectionController_->getGestures().begin();
-                    gtr != intersectionController_->getGestures().end(); ++gtr)
-                {
-                    if ((*gtr).type() == Leap::Gesture::TYPE_SCREEN_TAP)
-                    {
-#ifdef LEAPSDK_1X_COMPATIBILITY
-						Leap::PointableList pointables = (*gtr).pointables();
-#else
-						Leap::PointableList pointables = (*gtr).pointables().extended();
-#endif
-                        for (Leap::PointableList::const_iterator ptr = pointables.begin();
-                            ptr != pointables.end(); ++ptr)
-                        {
-                            Leap::Pointable pointable = (*ptr);
-                            if (pointable.id() == itr->first)
-                            {
-                                if (allowedToClick(itr->second)) {
-                                    doClick = true;
-                                }
-                            }
-                        }
-                    }
+                if (std::binary_search(tappedIDs_.begin(), tappedIDs_.end(), itr->first)) {
+                    if (allowedToClick(itr->second)) doClick = true;
+                }
+            } else if (clickMode_ == VELOCITY_TAP) {
+                // Feed the detector every frame, not only above targets
+                Pointer* p = itr->second.get();
+                if (tapDetector_->update(p->getTapState(), p->getTipPosition(), p->getTimestamp(), normal)) {
+                    if (allowedToClick(p)) doClick = true;
                 }
             }
 
             if (doClick) {
+                FlightRecorder::instance()->recordClick(intersectionController_->getLastFrame().id(), itr->first, itr->second->getPosition());
                 if (emulationMode_ == MOUSE) {
                     // Fire a mouse press and a mouse release event on "left mouse button"
                     mouseButton(itr->second, osgGA::GUIEventAdapter::LEFT_MOUSE_BUTTON, osgGA::GUIEventAdapter::PUSH);
                     mouseButton(itr->second, osgGA::GUIEventAdapter::LEFT_MOUSE_BUTTON, osgGA::GUIEventAdapter::RELEASE);
+                    numEvents += 2;
                 } else if (emulationMode_ == TOUCH) {
                     // Fire a touch began and a touch ended event with 1 tap
                     touchBegan(itr->second);
                     touchEnded(itr->second, 1);
+                    numEvents += 2;
                 }
             }
         }
+
+        span.setCounter(0, "pointers", pointers.size());
+        span.setCounter(1, "events", numEvents);
     }
 
 } // namespace osgLeap
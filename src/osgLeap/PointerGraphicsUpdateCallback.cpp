@@ -10,15 +10,201 @@
 
 #include <osgLeap/PointerGraphicsUpdateCallback>
 
+//-- Project --//
+#include <osgLeap/HUDCamera>
+#include <osgLeap/TraceRecorder>
+
 //-- OSG: osg --//
 #include <osg/io_utils>
 #include <osg/Material>
+#include <osg/NodeVisitor>
 #include <osg/PositionAttitudeTransform>
 #include <osg/ShapeDrawable>
+#include <osg/State>
 #include <osg/ValueObject>
 
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+
 namespace osgLeap {
 
+    // Latches the pointer positions right before the camera draws, after
+    // the pre-draw callback it replaces
+    class PointerLatchDrawCallback: public osg::Camera::DrawCallback {
+    public:
+        PointerLatchDrawCallback(PointerGraphicsUpdateCallback* puc, osg::Camera::DrawCallback* previous): osg::Camera::DrawCallback(),
+            puc_(puc), previous_(previous)
+        {
+
+        }
+
+        virtual void operator()(osg::RenderInfo& renderInfo) const
+        {
+            if (previous_.valid()) (*previous_)(renderInfo);
+
+            osg::ref_ptr<PointerGraphicsUpdateCallback> puc;
+            if (puc_.lock(puc)) {
+                puc->latch();
+            }
+        }
+
+    protected:
+        osg::observer_ptr<PointerGraphicsUpdateCallback> puc_;
+        osg::ref_ptr<osg::Camera::DrawCallback> previous_;
+    };
+
+    // Draws a drawable of a pointer moved by the offset of its slot. HUD
+    // coordinates are pixels, so the offset is added in eye space. Only the
+    // model view matrix changes, so the pointer keeps its fixed-function
+    // or shader state, materials and lighting.
+    class PointerLatchDrawableCallback: public osg::Drawable::DrawCallback {
+    public:
+        PointerLatchDrawableCallback(PointerGraphicsUpdateCallback::LatchOffsets* offsets, int slot, osg::Drawable::DrawCallback* previous):
+            osg::Drawable::DrawCallback(), offsets_(offsets), slot_(slot), previous_(previous), shifted_(new osg::RefMatrix())
+        {
+
+        }
+
+        virtual void drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable* drawable) const
+        {
+            osg::State& state = *renderInfo.getState();
+            const osg::Vec2& offset = offsets_->offsets[slot_];
+            const bool shift = (offset.x() != 0.0f || offset.y() != 0.0f);
+            osg::Matrix modelView;
+            if (shift) {
+                modelView = state.getModelViewMatrix();
+                shifted_->set(modelView*osg::Matrix::translate(offset.x(), offset.y(), 0.0f));
+                state.applyModelViewMatrix(shifted_.get());
+            }
+
+            if (previous_.valid()) {
+                previous_->drawImplementation(renderInfo, drawable);
+            } else {
+                drawable->drawImplementation(renderInfo);
+            }
+
+            if (shift) state.applyModelViewMatrix(modelView);
+        }
+
+    protected:
+        osg::ref_ptr<PointerGraphicsUpdateCallback::LatchOffsets> offsets_;
+        int slot_;
+        osg::ref_ptr<osg::Drawable::DrawCallback> previous_;
+        // Used by the draw thread only
+        osg::ref_ptr<osg::RefMatrix> shifted_;
+    };
+
+    // Installs PointerLatchDrawableCallbacks on the drawables of a pointer
+    class PointerLatchVisitor: public osg::NodeVisitor {
+    public:
+        PointerLatchVisitor(PointerGraphicsUpdateCallback::LatchOffsets* offsets, int slot):
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), offsets_(offsets), slot_(slot) {}
+
+        virtual void apply(osg::Geode& geode)
+        {
+            for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+                osg::Drawable* drawable = geode.getDrawable(i);
+                // A display list would record the offset of its first draw.
+                // The draw thread reads the offsets, so do not let the next
+                // update run before drawing has finished.
+                drawable->setUseDisplayList(false);
+                drawable->setDataVariance(osg::Object::DYNAMIC);
+                drawable->setDrawCallback(new PointerLatchDrawableCallback(offsets_, slot_, drawable->getDrawCallback()));
+            }
+        }
+
+    protected:
+        PointerGraphicsUpdateCallback::LatchOffsets* offsets_;
+        int slot_;
+    };
+
+    void PointerGraphicsUpdateCallback::initLatching()
+    {
+        if (!latchOffsets_.valid()) latchOffsets_ = new LatchOffsets();
+        for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+            latchIDs_[i] = -1;
+            latchOffsets_->offsets[i].set(0.0f, 0.0f);
+        }
+    }
+
+    void PointerGraphicsUpdateCallback::setLateLatching(osg::Camera* drawCamera)
+    {
+        // Put back what the latch callback replaced. If somebody has
+        // replaced the latch callback meanwhile, leave theirs alone.
+        osg::ref_ptr<osg::Camera> oldCamera;
+        if (latchCamera_.lock(oldCamera) && latchCallback_.valid() && oldCamera->getPreDrawCallback() == latchCallback_.get()) {
+            oldCamera->setPreDrawCallback(latchPreviousCallback_.get());
+        }
+        latchCamera_ = drawCamera;
+        latchCallback_ = NULL;
+        latchPreviousCallback_ = NULL;
+
+        if (drawCamera != NULL) {
+            latchPreviousCallback_ = drawCamera->getPreDrawCallback();
+            latchCallback_ = new PointerLatchDrawCallback(this, latchPreviousCallback_.get());
+            drawCamera->setPreDrawCallback(latchCallback_.get());
+        }
+
+        // Pointers are drawn at their update traversal positions until the
+        // next latch
+        for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+            latchOffsets_->offsets[i].set(0.0f, 0.0f);
+        }
+    }
+
+    void PointerGraphicsUpdateCallback::latch()
+    {
+        if (!latchCamera_.valid()) return;
+        if (latchSuspended_.load() != 0) {
+            // The pointers go into the HUD's cache texture, which is drawn
+            // again in later frames: keep them where the events are
+            for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+                latchOffsets_->offsets[i].set(0.0f, 0.0f);
+            }
+            return;
+        }
+        OSGLEAP_TRACE_SPAN(span, "PointerGraphicsUpdateCallback::latch");
+
+        intersectionController_->latchPointables(latchBatch_);
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(latchMutex_);
+        for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+            osg::Vec2 offset(0.0f, 0.0f);
+            if (latchIDs_[i] >= 0) {
+                for (unsigned int j = 0; j < latchBatch_.size(); ++j) {
+                    if (latchBatch_.ids[j] == latchIDs_[i] && latchBatch_.valid[j]) {
+                        offset.set(latchBatch_.screenX[j]-latchPositions_[i].x(), latchBatch_.screenY[j]-latchPositions_[i].y());
+                        break;
+                    }
+                }
+            }
+            latchOffsets_->offsets[i] = offset;
+        }
+    }
+
+    int PointerGraphicsUpdateCallback::acquireSlot(int pointableID)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(latchMutex_);
+        for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+            if (latchIDs_[i] < 0) {
+                latchIDs_[i] = pointableID;
+                latchPositions_[i].set(0.0f, 0.0f);
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    void PointerGraphicsUpdateCallback::releaseSlot(int pointableID)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(latchMutex_);
+        for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+            if (latchIDs_[i] == pointableID) {
+                latchIDs_[i] = -1;
+            }
+        }
+    }
+
     osg::ref_ptr<osg::Node> PointerGraphicsUpdateCallback::createPointerGeode(unsigned int /*num*/) {
         osg::ref_ptr<osg::Geode> sphere = new osg::Geode();
         float radius = 10.0f;
@@ -77,69 +263,114 @@ namespace osgLeap {
 
     void osgLeap::PointerGraphicsUpdateCallback::operator()(osg::Node* node, osg::NodeVisitor* nv)
     {
+        OSGLEAP_TRACE_SPAN(span, "PointerGraphicsUpdateCallback");
         // Grab data from Leap Motion
         intersectionController_->update();
+        span.setFrameID(intersectionController_->getLastFrame().id());
 
         // Now update our Geode to display the pointers
         osg::ref_ptr<osg::Group> group = dynamic_cast<osg::Group*>(node);
         if (group.valid()) {
             group->setDataVariance(osg::Object::DYNAMIC);
+            if (latchCamera_.valid()) latchSuspended_.store(HUDCamera::hasCachedParent(group.get()) ? 1 : 0);
 
-            osgLeap::PointerMap pointers = intersectionController_->getPointers();
+            const osgLeap::PointerMap& pointers = intersectionController_->getPointers();
+            span.setCounter(0, "pointers", pointers.size());
+
+            // The transforms are kept from frame to frame, so a steady
+            // set of pointers does not allocate. Start over if children were
+            // removed behind our back.
+            if (transforms_.size() > group->getNumChildren()) {
+                transforms_.clear();
+                initLatching();
+            }
 
-            PatMap transforms;
+            // Whether anything the HUD shows has changed
+            bool changed = false;
             // Remove any pointers not visible anymore
             for (int n = group->getNumChildren()-1; n >= 0; --n) {
                 int pid = -1;
                 bool remove = true;
                 if (group->getChild(n)->getUserValue<int>("PointableID", pid)) {
-                    for (osgLeap::PointerMap::iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
-                        // Still visible in current frame
-                        if (itr->first == pid) remove = false;
-                    }
+                    // Still visible in current frame
+                    remove = (pointers.find(pid) == pointers.end());
                 }
                 if (remove) {
                     group->removeChild(n);
-                } else {
-                    transforms.insert(PatPair(pid, dynamic_cast<osg::PositionAttitudeTransform*>(group->getChild(n))));
+                    transforms_.erase(pid);
+                    releaseSlot(pid);
+                    changed = true;
+                } else if (transforms_.find(pid) == transforms_.end()) {
+                    transforms_.insert(PatPair(pid, dynamic_cast<osg::PositionAttitudeTransform*>(group->getChild(n))));
                 }
             }
 
             // Add more pointers if required or update if they have moved
-            for (osgLeap::PointerMap::iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
-                osg::ref_ptr<osgLeap::Pointer> p = itr->second;
+            for (osgLeap::PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+                osgLeap::Pointer* p = itr->second.get();
 
-                PatMap::iterator patitr = transforms.find(itr->first);
-                osg::ref_ptr<osg::PositionAttitudeTransform> pat = NULL;
-                if (patitr != transforms.end()) {
-                    pat = patitr->second;
+                PatMap::iterator patitr = transforms_.find(itr->first);
+                osg::PositionAttitudeTransform* pat = NULL;
+                if (patitr != transforms_.end()) {
+                    pat = patitr->second.get();
                     if (referenceTime_ != 0) {
                         osg::Geode* geode = dynamic_cast<osg::Geode*>(pat->getChild(0));
                         if (geode) {
                             osg::ShapeDrawable* sd = dynamic_cast<osg::ShapeDrawable*>(geode->getDrawable(0));
-                            float f = 1-p->clickTimeProgress(referenceTime_);
+                            float f = 1-p->getDwellProgress();
                             osg::Vec4 color(sd->getColor().x(), sd->getColor().y(), sd->getColor().z(), f);
-                            sd->setColor(color);
-                            sd->getOrCreateStateSet()->setMode(GL_BLEND, osg::StateAttribute::ON);
-                            sd->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+                            if (color != sd->getColor()) {
+                                sd->setColor(color);
+                                sd->getOrCreateStateSet()->setMode(GL_BLEND, osg::StateAttribute::ON);
+                                sd->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+                                changed = true;
+                            }
                         }
                     }
                 } else {
                     // Add new pointer
-					osg::ref_ptr<osg::Node> pt = createPointerGeode(transforms.size());
+					osg::ref_ptr<osg::Node> pt = createPointerGeode(transforms_.size());
 					if (pt.valid()) {
 						pat = new osg::PositionAttitudeTransform();
 						pat->setUserValue<int>("PointableID", itr->first);
 						pat->addChild(pt);
+						// Slot of the late latching offsets
+						const int slot = acquireSlot(itr->first);
+						if (slot >= 0) {
+							PointerLatchVisitor plv(latchOffsets_.get(), slot);
+							pt->accept(plv);
+						}
 						// Add to scene graph
 						group->addChild(pat);
 						// Add to local reference map
-						transforms.insert(PatPair(itr->first, pat));
+						transforms_.insert(PatPair(itr->first, pat));
+						changed = true;
 					}
                 }
 
                 osg::Vec3 vec = osg::Vec3(p->getPosition().x(), p->getPosition().y(), 0.0f);
-				if (pat.valid()) pat->setPosition(vec);
+				if (pat != NULL && pat->getPosition() != vec) {
+					pat->setPosition(vec);
+					changed = true;
+				}
+            }
+
+            // Positions the late latching offsets are relative to
+            if (latchCamera_.valid()) {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(latchMutex_);
+                for (unsigned int i = 0; i < MAX_LATCHED_POINTERS; ++i) {
+                    if (latchIDs_[i] < 0) continue;
+                    osgLeap::PointerMap::const_iterator pitr = pointers.find(latchIDs_[i]);
+                    if (pitr != pointers.end()) {
+                        latchPositions_[i] = pitr->second->getPosition();
+                    }
+                }
+            }
+
+            // Pointers moving, fading, appearing or disappearing require a
+            // cached HUD to be rendered again; resting pointers do not
+            if (changed) {
+                HUDCamera::dirtyParents(group.get());
             }
         }
 
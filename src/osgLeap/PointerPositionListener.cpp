@@ -10,136 +10,258 @@
 
 #include <osgLeap/PointerPositionListener>
 
+//-- Project --//
+#include <osgLeap/FlightRecorder>
+#include <osgLeap/TraceRecorder>
+
 //-- OSG: osg --//
 #include <osg/CopyOp>
 #include <osg/Referenced>
 #include <osg/Timer>
 
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+
 //-- STL --//
-#include <list>
+#include <algorithm>
 
 namespace osgLeap {
 
+    // Maps the pointables of each frame on a worker of the processing graph
+    class PointerMappingStage: public FrameProcessingGraph::Stage {
+    public:
+        PointerMappingStage(PointerPositionListener* listener): FrameProcessingGraph::Stage("PointerPositionListener"),
+            listener_(listener)
+        {
+
+        }
+
+        virtual void process(const Leap::Frame& frame)
+        {
+            PointerPositionListener::MappedFrame& mapped = listener_->mapped_.getWriteBuffer();
+            mapped.frame = frame;
+            listener_->mapFrame(frame, mapped.batch);
+            listener_->mapped_.publish();
+        }
+
+    protected:
+        PointerPositionListener* listener_;
+    };
+
     PointerPositionListener::PointerPositionListener(int windowwidth, int windowheight): osgLeap::Listener(),
-        frame_(Leap::Frame()), lastFrame_(Leap::Frame()), camera_(NULL),
-        gestures_(Leap::GestureList())
+        lastFrame_(Leap::Frame()), camera_(NULL),
+        gestures_(Leap::GestureList()),
+        screenModel_(new ScreenModel()),
+        dwellEngine_(new DwellEngine())
     {
         controller_.addListener(*this);
-		controller_.enableGesture(Leap::Gesture::TYPE_SCREEN_TAP);
     }
 
      PointerPositionListener::PointerPositionListener(osg::Camera* camera): camera_(camera),
-            windowwidth_(800), windowheight_(600), frame_(Leap::Frame()), lastFrame_(Leap::Frame()),
-            gestures_(Leap::GestureList())
+            windowwidth_(800), windowheight_(600), lastFrame_(Leap::Frame()),
+            gestures_(Leap::GestureList()),
+            screenModel_(new ScreenModel()),
+            dwellEngine_(new DwellEngine())
     {
         controller_.addListener(*this);
-		controller_.enableGesture(Leap::Gesture::TYPE_SCREEN_TAP);
     }
 
     PointerPositionListener::~PointerPositionListener()
     {
+        setProcessingGraph(NULL);
         controller_.removeListener(*this);
     }
 
     PointerPositionListener::PointerPositionListener(const PointerPositionListener& lm,
-        const osg::CopyOp& copyOp): osgLeap::Listener(*this),
-        frame_(Leap::Frame()),
+        const osg::CopyOp& copyOp): osgLeap::Listener(lm, copyOp),
         lastFrame_(Leap::Frame()),
         gestures_(Leap::GestureList()),
         windowwidth_(lm.windowwidth_),
         windowheight_(lm.windowheight_),
-        camera_(lm.camera_)
+        camera_(lm.camera_),
+        screenModel_(lm.screenModel_),
+        dwellEngine_(lm.dwellEngine_)
     {
 
     }
 
     void PointerPositionListener::setResolution(int windowwidth, int windowheight)
     {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(screenMutex_);
         windowwidth_ = windowwidth;
         windowheight_ = windowheight;
     }
 
-    void PointerPositionListener::onFrame(const Leap::Controller& controller)
+    void PointerPositionListener::featuresChanged(unsigned int features)
     {
-        // Get the most recent frame and store it to later use in handle(...)
-        frame_ = controller.frame();
+        controller_.enableGesture(Leap::Gesture::TYPE_CIRCLE, (features & FEATURE_GESTURE_CIRCLE) != 0);
+        controller_.enableGesture(Leap::Gesture::TYPE_SWIPE, (features & FEATURE_GESTURE_SWIPE) != 0);
+        controller_.enableGesture(Leap::Gesture::TYPE_KEY_TAP, (features & FEATURE_GESTURE_KEY_TAP) != 0);
+        controller_.enableGesture(Leap::Gesture::TYPE_SCREEN_TAP, (features & FEATURE_GESTURE_SCREEN_TAP) != 0);
+    }
 
-        // assume first screen is the one we want...
-        screen_ = controller.locatedScreens()[0];
+    void PointerPositionListener::onFrame(const Leap::Controller& controller)
+    {
+        OSGLEAP_TRACE_SPAN(span, "PointerPositionListener::onFrame");
+        // Get the most recent frame and pass it to update()
+        const Leap::Frame frame = controller.frame();
+        span.setFrameID(frame.id());
+        FlightRecorder::instance()->recordFrame(frame);
+        postFrame(frame);
     }
 
-    void PointerPositionListener::update()
+    void PointerPositionListener::fillBatch(const Leap::Frame& frame, PointableBatch& batch)
     {
 #ifdef LEAPSDK_1X_COMPATIBILITY
-        Leap::PointableList pl = frame_.pointables();
+        Leap::PointableList pl = frame.pointables();
 #else
-		Leap::PointableList pl = frame_.pointables().extended();
+        Leap::PointableList pl = frame.pointables().extended();
 #endif
-        Leap::Screen screen = screen_;
-        gestures_ = frame_.gestures(lastFrame_);
+        for (Leap::PointableList::const_iterator itr = pl.begin(); itr != pl.end(); ++itr) {
+            const Leap::Vector tip = (*itr).stabilizedTipPosition();
+            const Leap::Vector dir = (*itr).direction();
+            const Leap::Vector raw = (*itr).tipPosition();
+            batch.add((*itr).id(), osg::Vec3(tip.x, tip.y, tip.z), osg::Vec3(dir.x, dir.y, dir.z),
+                osg::Vec3(raw.x, raw.y, raw.z));
+        }
+    }
+
+    void PointerPositionListener::setProcessingGraph(FrameProcessingGraph* graph)
+    {
+        if (graph == graph_.get()) return;
+        if (graph_.valid()) {
+            // Waits until the stage is not running anymore
+            graph_->removeStage(mappingStage_.get());
+        }
+        graph_ = graph;
+        if (graph_.valid()) {
+            if (!mappingStage_.valid()) mappingStage_ = new PointerMappingStage(this);
+            graph_->addStage(mappingStage_.get());
+        }
+    }
+
+    void PointerPositionListener::mapFrame(const Leap::Frame& frame, PointableBatch& batch)
+    {
+        // Without consumers of pointables and their screen intersections,
+        // the batch stays empty and all pointers are removed.
+        batch.clear();
+        const unsigned int features = getFeatures();
+        if (!(features & FEATURE_POINTABLES) || !(features & FEATURE_SCREEN_INTERSECTIONS)) return;
+
+        fillBatch(frame, batch);
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(screenMutex_);
+        Leap::InteractionBox box = frame.interactionBox();
+        if (box.isValid()) {
+            screenModel_->setInteractionBox(osg::Vec3(box.center().x, box.center().y, box.center().z),
+                osg::Vec3(box.width(), box.height(), box.depth()));
+        }
+        screenModel_->intersect(batch, windowwidth_, windowheight_);
+    }
+
+    void PointerPositionListener::latchPointables(PointableBatch& batch)
+    {
+        batch.clear();
+        // Newest frame of the service, not the one handed to onFrame
+        Leap::Frame frame = controller_.frame();
+        if (!frame.isValid()) return;
+
+        fillBatch(frame, batch);
+
+        // The resolution is written by update() and setResolution() on
+        // other threads, so read it under the lock as well
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(screenMutex_);
+        screenModel_->intersect(batch, windowwidth_, windowheight_);
+    }
+
+    void PointerPositionListener::update()
+    {
+        OSGLEAP_TRACE_SPAN(span, "PointerPositionListener::update");
+        // Grab the frame to work on, already mapped by the processing graph
+        // if there is one
+        const PointableBatch* batch = &batch_;
+        Leap::Frame frame;
+        if (graph_.valid()) {
+            mapped_.update();
+            frame = mapped_.getReadBuffer().frame;
+            batch = &mapped_.getReadBuffer().batch;
+        } else {
+            frame = fetchFrame();
+        }
+        span.setFrameID(frame.id());
+        // Only ask the SDK for gestures somebody has asked for
+        if (getFeatures() & FEATURE_GESTURES) {
+            gestures_ = frame.gestures(lastFrame_);
+        } else if (!gestures_.isEmpty()) {
+            gestures_ = Leap::GestureList();
+        }
         removedPointers_.clear();
 
         // Auto-update to reference camera's resolution
         // Please use setResolution to update manually, if this PointerPositionListener
         // is constructed without reference camera.
-        if (camera_ != NULL) {
-			windowheight_ = camera_->getViewport()->height();
-            windowwidth_  = camera_->getViewport()->width();
+        osg::Vec2 resolution;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(screenMutex_);
+            if (camera_ != NULL) {
+                windowheight_ = camera_->getViewport()->height();
+                windowwidth_  = camera_->getViewport()->width();
+            }
+            resolution.set(windowwidth_, windowheight_);
+        }
+
+        // Collect all pointables into one batch and map them to the screen
+        // in a single pass instead of asking the SDK once per pointable.
+        if (!graph_.valid()) {
+            mapFrame(frame, batch_);
         }
-        osg::Vec2 resolution(windowwidth_, windowheight_);
 
         // Update pointers as required. Add new pointers where additional pointables
         // result in a valid intersection.
-        std::list<int> validIDs;
-        for (Leap::PointableList::const_iterator itr = pl.begin(); itr != pl.end(); ++itr) {
-            Leap::Vector pos = screen.intersect(*itr, true);
-            // Calculate pixel screen position from relative Leap values [X: 0.0 to 1.0, Y: 0.0 to 1.0]
-            // using the 3D window resolution. Z is always zero.
-            pos.x = std::ceil(pos.x * windowwidth_);
-            pos.y = std::ceil(pos.y * windowheight_);
-
+        validIDs_.clear();
+        const long long timestamp = frame.timestamp();
+        // Dwell time passes with the tracking frames, not with the calls
+        const bool newFrame = (frame.id() != lastFrame_.id());
+        for (unsigned int i = 0; i < batch->size(); ++i) {
             // skip pointable if no valid intersection
-            if (!pos.isValid()) { continue; }
+            if (!batch->valid[i]) { continue; }
+            const int id = batch->ids[i];
+            const osg::Vec2 pos(batch->screenX[i], batch->screenY[i]);
+            const osg::Vec3 tip(batch->rawTipX[i], batch->rawTipY[i], batch->rawTipZ[i]);
             // lookup Pointer for this pointable
-            PointerMap::iterator pointer = pointers_.find((*itr).id());
-            validIDs.push_back((*itr).id());
+            PointerMap::iterator pointer = pointers_.find(id);
+            validIDs_.push_back(id);
             if (pointer == pointers_.end()) {
                 // Not found: Add a new pointer
-                osg::ref_ptr<Pointer> newPointer = new Pointer(osg::Vec2(pos.x, pos.y), resolution, (*itr).id());
-                pointers_.insert(PointerPair((*itr).id(), newPointer));
+                osg::ref_ptr<Pointer> newPointer = new Pointer(pos, resolution, id);
+                newPointer->setTipPosition(tip, timestamp);
+                dwellEngine_->advance(newPointer->getDwellState(), pos, timestamp);
+                pointers_.insert(PointerPair(id, newPointer));
             } else {
                 // Found: Update pointer position
-                pointer->second->setPosition(pos.x, pos.y);
+                pointer->second->setPosition(pos);
                 pointer->second->setResolution(resolution);
+                pointer->second->setTipPosition(tip, timestamp);
+                if (newFrame) dwellEngine_->advance(pointer->second->getDwellState(), pos, timestamp);
             }
         }
 
-        // Lookup unused pointers
-        std::list<int> unusedIDs;
-        for (PointerMap::const_iterator itr = pointers_.begin(); itr != pointers_.end(); ++itr) {
-            bool found = false;
-            for (std::list<int>::const_iterator iitr = validIDs.begin(); iitr != validIDs.end(); ++iitr) {
-                if (itr->first == *iitr) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                unusedIDs.push_back(itr->first);
-            }
-        }
-
-        // Remove unused pointers
-        for (std::list<int>::iterator itr = unusedIDs.begin(); itr != unusedIDs.end(); ++itr) {
-            PointerMap::iterator pitr  = pointers_.find(*itr);
-            if (pitr != pointers_.end()) {
-                removedPointers_.insert(PointerPair((*pitr).first, (*pitr).second));
-                pointers_.erase(pitr);
+        // Remove unused pointers. validIDs_ keeps its capacity, so this
+        // does not allocate unless pointers disappear.
+        std::sort(validIDs_.begin(), validIDs_.end());
+        for (PointerMap::iterator itr = pointers_.begin(); itr != pointers_.end(); ) {
+            if (!std::binary_search(validIDs_.begin(), validIDs_.end(), itr->first)) {
+                removedPointers_.insert(PointerPair(itr->first, itr->second));
+                pointers_.erase(itr++);
+            } else {
+                ++itr;
             }
         }
 
         // Remember the last frame we handled
-        lastFrame_ = frame_;
+        lastFrame_ = frame;
+        span.setCounter(0, "pointers", pointers_.size());
+        span.setCounter(1, "removed", removedPointers_.size());
 
     }
 
@@ -0,0 +1,201 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/QualityGovernor>
+
+//-- OSG: osg --//
+#include <osg/FrameStamp>
+#include <osg/NodeVisitor>
+#include <osg/Stats>
+
+//-- STL --//
+#include <algorithm>
+#include <cmath>
+
+namespace osgLeap {
+
+    // Recorded by osgViewer::Renderer, in seconds
+    static const std::string sCullTimeName("Cull traversal time taken");
+    static const std::string sDrawTimeName("Draw traversal time taken");
+
+    QualityGovernor::QualityGovernor(osgLeap::OrbitManipulator* manipulator, osg::Camera* camera): osg::NodeCallback(),
+        manipulator_(manipulator),
+        camera_(camera),
+        frameBudget_(1.0/60.0),
+        restoreDuration_(1.0),
+        adaptationRate_(2.0f),
+        baseLODScale_(camera != NULL ? camera->getLODScale() : 1.0f),
+        maxLODScale_(4.0f),
+        baseSmallFeatureCullingPixelSize_(camera != NULL ? camera->getSmallFeatureCullingPixelSize() : 2.0f),
+        maxSmallFeatureCullingPixelSize_(8.0f),
+        degradation_(0.0f),
+        appliedDegradation_(0.0f),
+        lastTime_(-1.0),
+        frameTime_(0.0)
+    {
+
+    }
+
+    QualityGovernor::QualityGovernor(): osg::NodeCallback(),
+        manipulator_(NULL),
+        camera_(NULL),
+        frameBudget_(1.0/60.0),
+        restoreDuration_(1.0),
+        adaptationRate_(2.0f),
+        baseLODScale_(1.0f),
+        maxLODScale_(4.0f),
+        baseSmallFeatureCullingPixelSize_(2.0f),
+        maxSmallFeatureCullingPixelSize_(8.0f),
+        degradation_(0.0f),
+        appliedDegradation_(0.0f),
+        lastTime_(-1.0),
+        frameTime_(0.0)
+    {
+
+    }
+
+    QualityGovernor::QualityGovernor(const QualityGovernor& qg, const osg::CopyOp& op): osg::NodeCallback(qg, op),
+        manipulator_(qg.manipulator_),
+        camera_(qg.camera_),
+        frameBudget_(qg.frameBudget_),
+        restoreDuration_(qg.restoreDuration_),
+        adaptationRate_(qg.adaptationRate_),
+        baseLODScale_(qg.baseLODScale_),
+        maxLODScale_(qg.maxLODScale_),
+        baseSmallFeatureCullingPixelSize_(qg.baseSmallFeatureCullingPixelSize_),
+        maxSmallFeatureCullingPixelSize_(qg.maxSmallFeatureCullingPixelSize_),
+        degradation_(0.0f),
+        appliedDegradation_(0.0f),
+        lastTime_(-1.0),
+        frameTime_(0.0)
+    {
+        // Expensive nodes are not copied, as only one governor may own
+        // their node masks
+    }
+
+    QualityGovernor::~QualityGovernor()
+    {
+        // Leave everything at full quality. Overrides of applyQuality are
+        // gone by now, see restore().
+        if (appliedDegradation_ != 0.0f) QualityGovernor::applyQuality(0.0f);
+    }
+
+    void QualityGovernor::restore()
+    {
+        degradation_ = 0.0f;
+        applyQuality(0.0f);
+        appliedDegradation_ = 0.0f;
+    }
+
+    bool QualityGovernor::measureFrameTime(unsigned int frameNumber)
+    {
+        osg::ref_ptr<osg::Camera> camera;
+        if (!camera_.lock(camera) || frameNumber < 2) return false;
+
+        if (camera->getStats() == NULL) camera->setStats(new osg::Stats("Camera"));
+        osg::Stats* stats = camera->getStats();
+        if (!stats->collectStats("rendering")) stats->collectStats("rendering", true);
+
+        // The current frame is not culled yet, and with threaded rendering
+        // the previous one may still be drawn, so average the last few
+        const unsigned int first = frameNumber > 4 ? frameNumber-4 : 0;
+        double cullTime = 0.0;
+        double drawTime = 0.0;
+        if (!stats->getAveragedAttribute(first, frameNumber-1, sCullTimeName, cullTime)) return false;
+        if (!stats->getAveragedAttribute(first, frameNumber-1, sDrawTimeName, drawTime)) return false;
+        frameTime_ = cullTime+drawTime;
+        return true;
+    }
+
+    void QualityGovernor::addExpensiveNode(osg::Node* node, float threshold)
+    {
+        if (node == NULL) return;
+        removeExpensiveNode(node);
+
+        ExpensiveNode en;
+        en.node = node;
+        en.nodeMask = node->getNodeMask();
+        en.threshold = threshold;
+        en.hidden = false;
+        expensiveNodes_.push_back(en);
+    }
+
+    void QualityGovernor::removeExpensiveNode(osg::Node* node)
+    {
+        for (std::vector<ExpensiveNode>::iterator itr = expensiveNodes_.begin(); itr != expensiveNodes_.end(); ++itr) {
+            if (itr->node.get() == node) {
+                if (itr->hidden) node->setNodeMask(itr->nodeMask);
+                expensiveNodes_.erase(itr);
+                return;
+            }
+        }
+    }
+
+    void QualityGovernor::operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        const osg::FrameStamp* fs = nv->getFrameStamp();
+        if (fs != NULL) {
+            double time = fs->getReferenceTime();
+            double dt = (lastTime_ >= 0.0) ? time-lastTime_ : 0.0;
+            lastTime_ = time;
+            // Long pauses (e.g. ON_DEMAND rendering while idle) do not tell
+            // anything about the rendering cost
+            if (dt > 0.0 && dt < 0.5) {
+                osg::ref_ptr<osgLeap::OrbitManipulator> manipulator;
+                bool manipulating = manipulator_.lock(manipulator) && manipulator->getCurrentAction() != OrbitManipulator::LM_None;
+
+                // Without a measurement the level is held while manipulating
+                bool measured = measureFrameTime(fs->getFrameNumber());
+
+                if (!manipulating) {
+                    degradation_ -= (restoreDuration_ > 0.0) ? dt/restoreDuration_ : 1.0f;
+                } else if (measured) {
+                    if (frameTime_ > frameBudget_) {
+                        degradation_ += adaptationRate_*dt;
+                    } else if (frameTime_ < 0.8*frameBudget_) {
+                        degradation_ -= 0.5f*adaptationRate_*dt;
+                    }
+                }
+                degradation_ = std::min(std::max(degradation_, 0.0f), 1.0f);
+            }
+        }
+
+        // Avoid touching the camera every frame for tiny changes
+        if (fabs(degradation_-appliedDegradation_) > 0.01f || (degradation_ == 0.0f && appliedDegradation_ != 0.0f)) {
+            applyQuality(degradation_);
+            appliedDegradation_ = degradation_;
+        }
+
+        traverse(node, nv);
+    }
+
+    void QualityGovernor::applyQuality(float degradation)
+    {
+        osg::ref_ptr<osg::Camera> camera;
+        if (camera_.lock(camera)) {
+            camera->setLODScale(baseLODScale_+degradation*(maxLODScale_-baseLODScale_));
+            camera->setSmallFeatureCullingPixelSize(baseSmallFeatureCullingPixelSize_+degradation*(maxSmallFeatureCullingPixelSize_-baseSmallFeatureCullingPixelSize_));
+        }
+
+        for (std::vector<ExpensiveNode>::iterator itr = expensiveNodes_.begin(); itr != expensiveNodes_.end(); ++itr) {
+            osg::ref_ptr<osg::Node> node;
+            if (!itr->node.lock(node)) continue;
+            bool hide = degradation > itr->threshold;
+            if (hide && !itr->hidden) {
+                itr->nodeMask = node->getNodeMask();
+                node->setNodeMask(0);
+            } else if (!hide && itr->hidden) {
+                node->setNodeMask(itr->nodeMask);
+            }
+            itr->hidden = hide;
+        }
+    }
+
+} // namespace osgLeap
@@ -0,0 +1,119 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/ScreenModel>
+
+//-- STL --//
+#include <algorithm>
+#include <cmath>
+
+namespace osgLeap {
+
+    ScreenModel::ScreenModel(): osg::Referenced(),
+        mode_(INTERACTION_BOX),
+        origin_(osg::Vec3(-200.0f, 100.0f, -200.0f)),
+        horizontal_(osg::Vec3(400.0f, 0.0f, 0.0f)),
+        vertical_(osg::Vec3(0.0f, 250.0f, 0.0f)),
+        boxCenter_(osg::Vec3(0.0f, 200.0f, 0.0f)),
+        boxSize_(osg::Vec3(235.0f, 235.0f, 147.0f)),
+        clampRatio_(1.0f)
+    {
+
+    }
+
+    void ScreenModel::setRectangle(const osg::Vec3& origin, const osg::Vec3& horizontal, const osg::Vec3& vertical)
+    {
+        origin_ = origin;
+        horizontal_ = horizontal;
+        vertical_ = vertical;
+        mode_ = RECTANGLE;
+    }
+
+    osg::Vec3 ScreenModel::getNormal() const
+    {
+        if (mode_ == INTERACTION_BOX) {
+            // Leap's z axis points towards the user
+            return osg::Vec3(0.0f, 0.0f, 1.0f);
+        }
+        osg::Vec3 n = horizontal_^vertical_;
+        n.normalize();
+        return n;
+    }
+
+    void ScreenModel::intersect(PointableBatch& batch, float width, float height) const
+    {
+        const unsigned int n = batch.size();
+        if (n == 0) return;
+
+        // Plain pointers into the arrays, so the loops below are simple
+        // enough for the compiler to vectorize
+        const float* tx = &batch.tipX[0];
+        const float* ty = &batch.tipY[0];
+        const float* tz = &batch.tipZ[0];
+        const float* dx = &batch.dirX[0];
+        const float* dy = &batch.dirY[0];
+        const float* dz = &batch.dirZ[0];
+        float* sx = &batch.screenX[0];
+        float* sy = &batch.screenY[0];
+        unsigned char* valid = &batch.valid[0];
+
+        // Accepted range of normalized coordinates (see setClampRatio)
+        const float lo = 0.5f-0.5f*clampRatio_;
+        const float hi = 0.5f+0.5f*clampRatio_;
+
+        if (mode_ == INTERACTION_BOX) {
+            const float cx = boxCenter_.x(), cy = boxCenter_.y();
+            const float isx = boxSize_.x() != 0.0f ? 1.0f/boxSize_.x() : 0.0f;
+            const float isy = boxSize_.y() != 0.0f ? 1.0f/boxSize_.y() : 0.0f;
+            for (unsigned int i = 0; i < n; ++i) {
+                float u = (tx[i]-cx)*isx+0.5f;
+                float v = (ty[i]-cy)*isy+0.5f;
+                valid[i] = (u >= lo) & (u <= hi) & (v >= lo) & (v <= hi);
+                sx[i] = std::min(std::max(u, 0.0f), 1.0f);
+                sy[i] = std::min(std::max(v, 0.0f), 1.0f);
+            }
+        } else {
+            const osg::Vec3 normal = horizontal_^vertical_;
+            const float nx = normal.x(), ny = normal.y(), nz = normal.z();
+            const float ox = origin_.x(), oy = origin_.y(), oz = origin_.z();
+            // Scale the axes so that the dot product directly yields 0..1
+            const float hl2 = horizontal_.length2();
+            const float vl2 = vertical_.length2();
+            const osg::Vec3 hs = hl2 > 0.0f ? horizontal_/hl2 : osg::Vec3();
+            const osg::Vec3 vs = vl2 > 0.0f ? vertical_/vl2 : osg::Vec3();
+            const float hx = hs.x(), hy = hs.y(), hz = hs.z();
+            const float vx = vs.x(), vy = vs.y(), vz = vs.z();
+            for (unsigned int i = 0; i < n; ++i) {
+                // Ray/plane intersection: tip + t*dir
+                float denom = dx[i]*nx+dy[i]*ny+dz[i]*nz;
+                float dist = (ox-tx[i])*nx+(oy-ty[i])*ny+(oz-tz[i])*nz;
+                // Rays parallel to or pointing away from the screen are
+                // rejected below, so just keep the division finite here
+                float t = dist/(denom < 0.0f ? denom : -1.0f);
+                float rx = tx[i]+t*dx[i]-ox;
+                float ry = ty[i]+t*dy[i]-oy;
+                float rz = tz[i]+t*dz[i]-oz;
+                float u = rx*hx+ry*hy+rz*hz;
+                float v = rx*vx+ry*vy+rz*vz;
+                valid[i] = (denom < 0.0f) & (t >= 0.0f) & (u >= lo) & (u <= hi) & (v >= lo) & (v <= hi);
+                sx[i] = std::min(std::max(u, 0.0f), 1.0f);
+                sy[i] = std::min(std::max(v, 0.0f), 1.0f);
+            }
+        }
+
+        // Calculate pixel screen position from the normalized values
+        // [X: 0.0 to 1.0, Y: 0.0 to 1.0] using the 3D window resolution
+        for (unsigned int i = 0; i < n; ++i) {
+            sx[i] = std::ceil(sx[i]*width);
+            sy[i] = std::ceil(sy[i]*height);
+        }
+    }
+
+} /* namespace osgLeap */
@@ -0,0 +1,166 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/SensorImageStream>
+
+//-- Project --//
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/BufferObject>
+#include <osg/Notify>
+
+//-- STL --//
+#include <cstring>
+
+namespace osgLeap {
+
+    SensorImageStream::SensorImageStream(unsigned int decimation): osg::NodeCallback(), Leap::Listener(),
+        decimation_(decimation > 0 ? decimation : 1)
+    {
+        init();
+    }
+
+    SensorImageStream::SensorImageStream(const SensorImageStream& sis,
+        const osg::CopyOp& copyOp): osg::NodeCallback(sis, copyOp), Leap::Listener(),
+        decimation_(sis.decimation_)
+    {
+        init();
+    }
+
+    SensorImageStream::~SensorImageStream()
+    {
+        controller_.removeListener(*this);
+    }
+
+    void SensorImageStream::init()
+    {
+        numPushed_ = 0;
+        numUploads_ = 0;
+        for (unsigned int c = 0; c < NUM_CAMERAS; ++c) {
+            lastSequence_[c] = -1;
+            osg::ref_ptr<osg::Image> image = new osg::Image();
+            image->setDataVariance(osg::Object::DYNAMIC);
+            image->setPixelBufferObject(new osg::PixelBufferObject(image.get()));
+            images_[c] = image;
+
+            // The texture keeps this image for good, update() never swaps it
+            osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(image.get());
+            texture->setDataVariance(osg::Object::DYNAMIC);
+            texture->setResizeNonPowerOfTwoHint(false);
+            texture->setUnRefImageDataAfterApply(false);
+            texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+            texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+            texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+            texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+            textures_[c] = texture;
+        }
+
+#ifdef LEAPSDK_1X_COMPATIBILITY
+        OSG_WARN<<"osgLeap::SensorImageStream: Sensor images require LeapSDK 2.1 or newer."<<std::endl;
+#else
+        controller_.setPolicyFlags((Leap::Controller::PolicyFlag)(controller_.policyFlags() | Leap::Controller::POLICY_IMAGES));
+        controller_.addListener(*this);
+#endif
+    }
+
+    void SensorImageStream::onFrame(const Leap::Controller& controller)
+    {
+#ifndef LEAPSDK_1X_COMPATIBILITY
+        OSGLEAP_TRACE_SPAN(span, "SensorImageStream::onFrame");
+        const Leap::ImageList images = controller.frame().images();
+        for (int i = 0; i < images.count(); ++i) {
+            const Leap::Image image = images[i];
+            const int camera = image.id();
+            if (!image.isValid() || camera < 0 || camera >= (int)NUM_CAMERAS) continue;
+            // Frames may arrive faster than images
+            if (image.sequenceId() == lastSequence_[camera]) continue;
+            lastSequence_[camera] = image.sequenceId();
+            if (image.bytesPerPixel() != 1) continue;
+
+            pushImage(camera, image.width(), image.height(), image.data());
+        }
+#endif
+    }
+
+    void SensorImageStream::pushImage(unsigned int camera, int width, int height, const unsigned char* data)
+    {
+        if (camera >= NUM_CAMERAS || width <= 0 || height <= 0 || data == NULL) return;
+
+        SensorImage& target = buffers_[camera].getWriteBuffer();
+        const unsigned int d = decimation_;
+        target.width = width/d;
+        target.height = height/d;
+        // Only grows, or shrinks if the decimation changes
+        target.data.resize(target.width*target.height);
+
+        if (d == 1) {
+            memcpy(&target.data[0], data, target.data.size());
+        } else {
+            // Average d x d blocks, dropping incomplete ones at the borders
+            const unsigned int area = d*d;
+            for (int y = 0; y < target.height; ++y) {
+                unsigned char* out = &target.data[y*target.width];
+                for (int x = 0; x < target.width; ++x) {
+                    unsigned int sum = 0;
+                    const unsigned char* in = data+(y*d)*width+x*d;
+                    for (unsigned int j = 0; j < d; ++j, in += width) {
+                        for (unsigned int i = 0; i < d; ++i) {
+                            sum += in[i];
+                        }
+                    }
+                    out[x] = (unsigned char)(sum/area);
+                }
+            }
+        }
+
+        buffers_[camera].publish();
+        ++numPushed_;
+    }
+
+    bool SensorImageStream::update()
+    {
+        OSGLEAP_TRACE_SPAN(span, "SensorImageStream::update");
+        bool changed = false;
+
+        for (unsigned int c = 0; c < NUM_CAMERAS; ++c) {
+            // Nothing to upload without a new image
+            if (!buffers_[c].update()) continue;
+            const SensorImage& source = buffers_[c].getReadBuffer();
+            if (source.data.empty()) continue;
+
+            // Rewritten in place: the draw thread is done with it as the
+            // StateSets using the texture are DYNAMIC. The pixel buffer
+            // object respecifies its whole store on upload, so the driver
+            // does not wait for the previous image's transfer either.
+            osg::Image* image = images_[c].get();
+            if (image->s() != source.width || image->t() != source.height) {
+                // Only on the first image and when the size changes
+                image->allocateImage(source.width, source.height, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+                image->setInternalTextureFormat(GL_LUMINANCE8);
+            }
+            memcpy(image->data(), &source.data[0], source.data.size());
+            image->dirty();
+
+            ++numUploads_;
+            changed = true;
+        }
+
+        span.setCounter(0, "uploads", changed ? 1 : 0);
+        return changed;
+    }
+
+    void SensorImageStream::operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        update();
+        traverse(node, nv);
+    }
+
+} /* namespace osgLeap */
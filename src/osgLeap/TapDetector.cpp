@@ -0,0 +1,80 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/TapDetector>
+
+namespace osgLeap {
+
+    TapDetector::TapDetector(): osg::Referenced(),
+        pressVelocity_(300.0f),
+        releaseVelocity_(100.0f),
+        minTravel_(8.0f),
+        maxDuration_(250000),
+        refractoryTime_(150000),
+        smoothing_(0.5f)
+    {
+
+    }
+
+    bool TapDetector::update(State& state, const osg::Vec3& tip, long long timestamp, const osg::Vec3& normal) const
+    {
+        // The normal points towards the user, a tap goes the other way
+        const float depth = -(tip*normal);
+
+        if (state.hasSample && timestamp <= state.timestamp) return false;
+        if (!state.hasSample || timestamp - state.timestamp > maxDuration_) {
+            // First sample or tracking was lost in between: start over
+            state = State();
+            state.hasSample = true;
+            state.timestamp = timestamp;
+            state.depth = depth;
+            return false;
+        }
+
+        const float dt = (float)(timestamp - state.timestamp)*1.0e-6f;
+        const float velocity = (depth - state.depth)/dt;
+        state.velocity += smoothing_*(velocity - state.velocity);
+
+        bool tap = false;
+        switch (state.phase) {
+        case IDLE:
+            if (state.velocity >= pressVelocity_) {
+                // The stroke began with the previous sample
+                state.phase = STROKE;
+                state.strokeDepth = state.depth;
+                state.strokeTime = state.timestamp;
+                state.fired = false;
+            }
+            break;
+        case STROKE:
+            break;
+        case REFRACTORY:
+            if (timestamp - state.strokeTime >= refractoryTime_) state.phase = IDLE;
+            break;
+        }
+
+        if (state.phase == STROKE) {
+            if (!state.fired && depth - state.strokeDepth >= minTravel_) {
+                // Fire once per stroke, and never for a slow push
+                tap = (timestamp - state.strokeTime <= maxDuration_);
+                state.fired = true;
+            }
+            if (state.velocity <= releaseVelocity_) {
+                state.phase = REFRACTORY;
+                state.strokeTime = timestamp;
+            }
+        }
+
+        state.timestamp = timestamp;
+        state.depth = depth;
+        return tap;
+    }
+
+} /* namespace osgLeap */
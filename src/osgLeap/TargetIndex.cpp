@@ -0,0 +1,169 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/TargetIndex>
+
+//-- STL --//
+#include <cmath>
+
+namespace osgLeap {
+
+    // Number of hash buckets (power of two)
+    static const unsigned int NUM_BUCKETS = 1024;
+
+    TargetIndex::TargetIndex(float cellSize): osg::Referenced(),
+        cellSize_(cellSize > 0.0f ? cellSize : 64.0f),
+        buckets_(NUM_BUCKETS),
+        numTargets_(0)
+    {
+
+    }
+
+    int TargetIndex::cell(float v) const
+    {
+        return (int)std::floor(v/cellSize_);
+    }
+
+    TargetIndex::CellRange TargetIndex::cells(const Target& t) const
+    {
+        CellRange range;
+        range.xMin = cell(t.xMin);
+        range.yMin = cell(t.yMin);
+        range.xMax = cell(t.xMax);
+        range.yMax = cell(t.yMax);
+        return range;
+    }
+
+    unsigned int TargetIndex::bucketIndex(int cx, int cy) const
+    {
+        return ((unsigned int)cx*73856093u ^ (unsigned int)cy*19349663u) & (NUM_BUCKETS-1);
+    }
+
+    void TargetIndex::insertCells(unsigned int id, const CellRange& range, const CellRange* except)
+    {
+        for (int cy = range.yMin; cy <= range.yMax; ++cy) {
+            for (int cx = range.xMin; cx <= range.xMax; ++cx) {
+                if (except != NULL && except->contains(cx, cy)) continue;
+                Entry e;
+                e.cx = cx;
+                e.cy = cy;
+                e.id = id;
+                buckets_[bucketIndex(cx, cy)].push_back(e);
+            }
+        }
+    }
+
+    void TargetIndex::eraseCells(unsigned int id, const CellRange& range, const CellRange* except)
+    {
+        for (int cy = range.yMin; cy <= range.yMax; ++cy) {
+            for (int cx = range.xMin; cx <= range.xMax; ++cx) {
+                if (except != NULL && except->contains(cx, cy)) continue;
+                Bucket& b = buckets_[bucketIndex(cx, cy)];
+                for (unsigned int i = 0; i < b.size(); ++i) {
+                    if (b[i].id == id && b[i].cx == cx && b[i].cy == cy) {
+                        // Order within a bucket does not matter
+                        b[i] = b.back();
+                        b.pop_back();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned int TargetIndex::addTarget(float xMin, float yMin, float xMax, float yMax,
+        osg::Node::NodeMask nodeMask, int depth, osg::Referenced* userData)
+    {
+        unsigned int id;
+        if (!freeIDs_.empty()) {
+            id = freeIDs_.back();
+            freeIDs_.pop_back();
+        } else {
+            targets_.push_back(Target());
+            id = targets_.size();
+        }
+
+        Target& t = targets_[id-1];
+        t.id = id;
+        t.xMin = xMin;
+        t.yMin = yMin;
+        t.xMax = xMax;
+        t.yMax = yMax;
+        t.nodeMask = nodeMask;
+        t.depth = depth;
+        t.userData = userData;
+        insertCells(id, cells(t));
+        ++numTargets_;
+        return id;
+    }
+
+    void TargetIndex::updateTarget(unsigned int id, float xMin, float yMin, float xMax, float yMax)
+    {
+        if (getTarget(id) == NULL) return;
+        Target& t = targets_[id-1];
+        if (t.xMin == xMin && t.yMin == yMin && t.xMax == xMax && t.yMax == yMax) return;
+
+        CellRange oldRange = cells(t);
+        t.xMin = xMin;
+        t.yMin = yMin;
+        t.xMax = xMax;
+        t.yMax = yMax;
+        CellRange newRange = cells(t);
+
+        eraseCells(id, oldRange, &newRange);
+        insertCells(id, newRange, &oldRange);
+    }
+
+    void TargetIndex::setTargetNodeMask(unsigned int id, osg::Node::NodeMask nodeMask)
+    {
+        if (getTarget(id) != NULL) targets_[id-1].nodeMask = nodeMask;
+    }
+
+    void TargetIndex::setTargetDepth(unsigned int id, int depth)
+    {
+        if (getTarget(id) != NULL) targets_[id-1].depth = depth;
+    }
+
+    void TargetIndex::removeTarget(unsigned int id)
+    {
+        if (getTarget(id) == NULL) return;
+        Target& t = targets_[id-1];
+        eraseCells(id, cells(t));
+        t = Target();
+        freeIDs_.push_back(id);
+        --numTargets_;
+    }
+
+    const TargetIndex::Target* TargetIndex::getTarget(unsigned int id) const
+    {
+        if (id == 0 || id > targets_.size() || targets_[id-1].id != id) return NULL;
+        return &targets_[id-1];
+    }
+
+    const TargetIndex::Target* TargetIndex::pick(float x, float y, osg::Node::NodeMask traversalMask) const
+    {
+        const int cx = cell(x);
+        const int cy = cell(y);
+        const Bucket& b = buckets_[bucketIndex(cx, cy)];
+
+        const Target* result = NULL;
+        for (unsigned int i = 0; i < b.size(); ++i) {
+            if (b[i].cx != cx || b[i].cy != cy) continue;
+            const Target& t = targets_[b[i].id-1];
+            if ((t.nodeMask & traversalMask) == 0) continue;
+            if (x < t.xMin || x > t.xMax || y < t.yMin || y > t.yMax) continue;
+            if (result == NULL || t.depth > result->depth || (t.depth == result->depth && t.id > result->id)) {
+                result = &t;
+            }
+        }
+        return result;
+    }
+
+} /* namespace osgLeap */
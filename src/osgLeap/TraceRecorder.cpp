@@ -0,0 +1,195 @@
+/*
+* Library osgLeap
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+#include <osgLeap/TraceRecorder>
+
+//-- OSG: osg --//
+#include <osg/Notify>
+
+//-- OpenThreads --//
+#include <OpenThreads/ScopedLock>
+
+//-- STL --//
+#include <cstdlib>
+#include <fstream>
+
+#if defined(_MSC_VER)
+#  define OSGLEAP_THREAD_LOCAL __declspec(thread)
+#else
+#  define OSGLEAP_THREAD_LOCAL __thread
+#endif
+
+namespace osgLeap {
+
+    volatile bool TraceRecorder::enabled_ = false;
+
+    // Buffer of the calling thread, registered on its first span
+    static OSGLEAP_THREAD_LOCAL void* sThreadBuffer = NULL;
+
+    static osg::ref_ptr<TraceRecorder>& recorderInstance()
+    {
+        static osg::ref_ptr<TraceRecorder> sRecorder = new TraceRecorder();
+        return sRecorder;
+    }
+
+    TraceRecorder* TraceRecorder::instance()
+    {
+        return recorderInstance().get();
+    }
+
+    // Create the recorder at load time, so OSGLEAP_TRACE is evaluated before
+    // the first frame and no thread has to race for the construction
+    static TraceRecorder* sInitTraceRecorder = TraceRecorder::instance();
+
+    // Chrome trace JSON string contents
+    static std::string escapeJSON(const std::string& s)
+    {
+        std::string result;
+        result.reserve(s.size());
+        for (std::string::const_iterator itr = s.begin(); itr != s.end(); ++itr) {
+            if (*itr == '"' || *itr == '\\') result += '\\';
+            result += *itr;
+        }
+        return result;
+    }
+
+    TraceRecorder::TraceRecorder(): osg::Referenced(),
+        startTick_(osg::Timer::instance()->tick()),
+        stopTime_(0),
+        bufferSize_(65536)
+    {
+        const char* filename = getenv("OSGLEAP_TRACE");
+        if (filename != NULL && filename[0] != '\0') {
+            exitFilename_ = filename;
+            enabled_ = true;
+        }
+    }
+
+    TraceRecorder::~TraceRecorder()
+    {
+        enabled_ = false;
+        if (!exitFilename_.empty()) {
+            write(exitFilename_);
+        }
+        for (std::vector<ThreadBuffer*>::iterator itr = buffers_.begin(); itr != buffers_.end(); ++itr) {
+            delete *itr;
+        }
+    }
+
+    void TraceRecorder::setEnabled(bool enabled)
+    {
+        stopTime_.store(0);
+        enabled_ = enabled;
+    }
+
+    void TraceRecorder::enableFor(double seconds)
+    {
+        const osg::Timer* timer = osg::Timer::instance();
+        const double stop = timer->delta_m(startTick_, timer->tick())+seconds*1000.0;
+        stopTime_.store(stop >= 1.0 ? (unsigned int)stop : 1);
+        enabled_ = true;
+    }
+
+    TraceRecorder::ThreadBuffer* TraceRecorder::getThreadBuffer()
+    {
+        if (sThreadBuffer == NULL) {
+            ThreadBuffer* buffer = new ThreadBuffer();
+            buffer->spans.resize(bufferSize_);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+            buffer->threadID = buffers_.size()+1;
+            buffers_.push_back(buffer);
+            sThreadBuffer = buffer;
+        }
+        return static_cast<ThreadBuffer*>(sThreadBuffer);
+    }
+
+    void TraceRecorder::setThreadName(const std::string& name)
+    {
+        ThreadBuffer* buffer = getThreadBuffer();
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        buffer->name = name;
+    }
+
+    void TraceRecorder::record(const Span& span)
+    {
+        const unsigned int stopTime = stopTime_.load();
+        if (stopTime != 0 && osg::Timer::instance()->delta_m(startTick_, span.end) > stopTime) {
+            // Only the first thread to get here disables recording, a later
+            // enableFor() or setEnabled() is not undone
+            if (stopTime_.exchange(0) == stopTime) enabled_ = false;
+            return;
+        }
+
+        ThreadBuffer* buffer = getThreadBuffer();
+        // Only this thread writes count
+        unsigned int index = buffer->count.load();
+        if (index >= buffer->spans.size()) return;
+        buffer->spans[index] = span;
+        // Make the span visible to write() only after it is complete
+        buffer->count.store(index+1);
+    }
+
+    bool TraceRecorder::write(const std::string& filename)
+    {
+        std::ofstream out(filename.c_str());
+        if (!out) {
+            OSG_WARN<<"osgLeap::TraceRecorder: Cannot write "<<filename<<std::endl;
+            return false;
+        }
+
+        const osg::Timer* timer = osg::Timer::instance();
+        unsigned int numSpans = 0;
+        bool first = true;
+
+        out<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":["<<std::endl;
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        for (std::vector<ThreadBuffer*>::const_iterator itr = buffers_.begin(); itr != buffers_.end(); ++itr) {
+            const ThreadBuffer* buffer = *itr;
+            if (!buffer->name.empty()) {
+                out<<(first ? "" : ",\n")<<"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"<<buffer->threadID
+                    <<",\"args\":{\"name\":\""<<escapeJSON(buffer->name)<<"\"}}";
+                first = false;
+            }
+
+            // Acquire, so the spans below count are complete
+            unsigned int count = buffer->count.load();
+            for (unsigned int i = 0; i < count; ++i) {
+                const Span& span = buffer->spans[i];
+                out<<(first ? "" : ",\n")<<"{\"ph\":\"X\",\"pid\":1,\"tid\":"<<buffer->threadID
+                    <<",\"name\":\""<<span.name<<"\""
+                    <<",\"ts\":"<<timer->delta_u(startTick_, span.start)
+                    <<",\"dur\":"<<timer->delta_u(span.start, span.end)
+                    <<",\"args\":{\"frame\":"<<span.frameID;
+                for (unsigned int c = 0; c < 2; ++c) {
+                    if (span.counterNames[c] != NULL) out<<",\""<<span.counterNames[c]<<"\":"<<span.counters[c];
+                }
+                out<<"}}";
+                first = false;
+            }
+            numSpans += count;
+        }
+
+        out<<std::endl<<"]}"<<std::endl;
+
+        OSG_NOTICE<<"osgLeap::TraceRecorder: Wrote "<<numSpans<<" spans to "<<filename<<std::endl;
+        return true;
+    }
+
+    void TraceRecorder::clear()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex_);
+        for (std::vector<ThreadBuffer*>::iterator itr = buffers_.begin(); itr != buffers_.end(); ++itr) {
+            (*itr)->count.store(0);
+        }
+    }
+
+} /* namespace osgLeap */
@@ -0,0 +1,326 @@
+/*
+* Test allocations
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Counts the heap allocations of the per-frame work of osgLeap and checks
+// them against a budget, per component and tracking frame:
+//
+//   PointerPositionListener::update, PointerGraphicsUpdateCallback
+//     None, unless pointers appear or disappear.
+//   PointerEventDevice::checkEvents
+//     What creating and queueing its events costs, see makeMouseEvent.
+//   Device::checkEvents
+//     What queueing its pooled event costs.
+//
+// A pointer appearing or disappearing may cost up to CHANGE_BUDGET
+// allocations (pointer, scene graph nodes, map entries).
+//
+// The global operator new is replaced, so allocations in the shared
+// libraries are counted as well. Only the main thread is counted, while a
+// component runs; the shim's service thread and onFrame are not.
+//
+// Usage: test_allocations <hover|dwell|churn>, with the frames of the
+// scenario fed by the shim (OSGLEAP_SHIM_FEED, see CMakeLists.txt).
+
+#include <osgLeap/Device>
+#include <osgLeap/PointerEventDevice>
+#include <osgLeap/PointerGraphicsUpdateCallback>
+#include <osgLeap/PointerPositionListener>
+
+#include <osg/Group>
+#include <osg/NodeVisitor>
+#include <osgGA/EventQueue>
+
+#include <OpenThreads/Thread>
+
+#include <Leap.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <vector>
+
+#if __cplusplus >= 201103L
+#define TEST_NOEXCEPT noexcept
+#else
+#define TEST_NOEXCEPT throw()
+#endif
+
+namespace {
+
+    // Frames run before counting starts, so lazily created state (pools,
+    // map nodes, vector capacity) is in place
+    const unsigned int WARMUP_FRAMES = 100;
+    const unsigned int MEASURED_FRAMES = 1000;
+    // Per pointer appearing or disappearing
+    const unsigned int CHANGE_BUDGET = 64;
+
+    __thread bool counting = false;
+    __thread unsigned int allocations = 0;
+
+    void beginCounting()
+    {
+        allocations = 0;
+        counting = true;
+    }
+
+    unsigned int endCounting()
+    {
+        counting = false;
+        return allocations;
+    }
+
+    void* allocate(std::size_t size)
+    {
+        if (counting) ++allocations;
+        return std::malloc(size > 0 ? size : 1);
+    }
+
+}
+
+void* operator new(std::size_t size)
+{
+    void* p = allocate(size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = allocate(size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) TEST_NOEXCEPT { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) TEST_NOEXCEPT { return allocate(size); }
+void operator delete(void* p) TEST_NOEXCEPT { std::free(p); }
+void operator delete[](void* p) TEST_NOEXCEPT { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) TEST_NOEXCEPT { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) TEST_NOEXCEPT { std::free(p); }
+
+namespace {
+
+    unsigned int drainEvents(osgGA::EventQueue* queue)
+    {
+        osgGA::EventQueue::Events events;
+        queue->takeEvents(events);
+        return (unsigned int)events.size();
+    }
+
+    // Allocations of queueing an existing event
+    unsigned int queueCost()
+    {
+        osg::ref_ptr<osgGA::EventQueue> queue = new osgGA::EventQueue();
+        osg::ref_ptr<osgGA::GUIEventAdapter> event = new osgGA::GUIEventAdapter();
+        beginCounting();
+        queue->addEvent(event.get());
+        const unsigned int result = endCounting();
+        drainEvents(queue.get());
+        return result;
+    }
+
+    // Allocations of creating and queueing an event like
+    // PointerEventDevice::mouseMotion does
+    unsigned int newEventCost()
+    {
+        osg::ref_ptr<osgGA::EventQueue> queue = new osgGA::EventQueue();
+        osgGA::GUIEventAdapter::getAccumulatedEventState();
+        beginCounting();
+        osg::ref_ptr<osgGA::GUIEventAdapter> event = new osgGA::GUIEventAdapter(*osgGA::GUIEventAdapter::getAccumulatedEventState());
+        queue->addEvent(event.get());
+        const unsigned int result = endCounting();
+        drainEvents(queue.get());
+        return result;
+    }
+
+    // A component run once per frame, with its allocations and budget
+    class Component {
+    public:
+        Component(const char* name, unsigned int eventCost = 0): name_(name), eventCost_(eventCost),
+            frames_(0), steadyAllocations_(0), changes_(0), changeAllocations_(0), failures_(0) {}
+        virtual ~Component() {}
+
+        void run(bool measure)
+        {
+            beginCounting();
+            step();
+            const unsigned int count = endCounting();
+
+            // Outside of the count
+            const unsigned int events = takeEvents();
+            const unsigned int changes = takeChanges();
+            if (!measure) return;
+
+            ++frames_;
+            const unsigned int budget = events*eventCost_ + changes*CHANGE_BUDGET;
+            if (changes == 0) {
+                steadyAllocations_ += count;
+            } else {
+                changes_ += changes;
+                changeAllocations_ += count;
+            }
+            if (count > budget) {
+                if (++failures_ <= 10) {
+                    std::cerr<<name_<<": "<<count<<" allocations in a frame, budget "<<budget
+                        <<" ("<<events<<" events, "<<changes<<" pointers changed)"<<std::endl;
+                }
+            }
+        }
+
+        bool report() const
+        {
+            std::cout<<name_<<": "<<frames_<<" frames, "<<steadyAllocations_<<" allocations in frames without pointer changes, "
+                <<changeAllocations_<<" for "<<changes_<<" pointer changes, "<<failures_<<" frames over budget"<<std::endl;
+            return failures_ == 0;
+        }
+
+    protected:
+        virtual void step() = 0;
+        // Events queued by step()
+        virtual unsigned int takeEvents() { return 0; }
+        // Pointers that appeared or disappeared in step()
+        virtual unsigned int takeChanges() { return 0; }
+
+        // Changes of the pointers of listener since the last call
+        unsigned int pointerChanges(const osgLeap::PointerPositionListener* listener)
+        {
+            ids_.clear();
+            const osgLeap::PointerMap& pointers = listener->getPointers();
+            for (osgLeap::PointerMap::const_iterator itr = pointers.begin(); itr != pointers.end(); ++itr) {
+                ids_.push_back(itr->first);
+            }
+            changed_.clear();
+            std::set_symmetric_difference(ids_.begin(), ids_.end(), lastIDs_.begin(), lastIDs_.end(), std::back_inserter(changed_));
+            ids_.swap(lastIDs_);
+            return (unsigned int)changed_.size();
+        }
+
+    private:
+        const char* name_;
+        unsigned int eventCost_;
+        unsigned int frames_;
+        unsigned int steadyAllocations_;
+        unsigned int changes_;
+        unsigned int changeAllocations_;
+        unsigned int failures_;
+        std::vector<int> ids_;
+        std::vector<int> lastIDs_;
+        std::vector<int> changed_;
+    };
+
+    class ListenerComponent: public Component {
+    public:
+        ListenerComponent(int dwellTime): Component("PointerPositionListener::update"),
+            listener_(new osgLeap::PointerPositionListener(1280, 1024))
+        {
+            listener_->requireFeatures(this, osgLeap::Listener::FEATURE_POINTABLES | osgLeap::Listener::FEATURE_SCREEN_INTERSECTIONS);
+            listener_->getDwellEngine()->setDwellTime(dwellTime);
+        }
+
+        ~ListenerComponent() { listener_->releaseFeatures(this); }
+
+    protected:
+        virtual void step() { listener_->update(); }
+        virtual unsigned int takeChanges() { return pointerChanges(listener_.get()); }
+
+    private:
+        osg::ref_ptr<osgLeap::PointerPositionListener> listener_;
+    };
+
+    class GraphicsComponent: public Component {
+    public:
+        GraphicsComponent(int referenceTime): Component("PointerGraphicsUpdateCallback"),
+            callback_(new osgLeap::PointerGraphicsUpdateCallback(1280, 1024, referenceTime)),
+            group_(new osg::Group()) {}
+
+    protected:
+        virtual void step() { (*callback_)(group_.get(), &visitor_); }
+        virtual unsigned int takeChanges() { return pointerChanges(callback_->getPointerPositionListener()); }
+
+    private:
+        osg::ref_ptr<osgLeap::PointerGraphicsUpdateCallback> callback_;
+        osg::ref_ptr<osg::Group> group_;
+        osg::NodeVisitor visitor_;
+    };
+
+    class EventDeviceComponent: public Component {
+    public:
+        // The dwell time is long enough not to click during the test
+        EventDeviceComponent(unsigned int eventCost): Component("PointerEventDevice::checkEvents", eventCost),
+            listener_(new osgLeap::PointerPositionListener(1280, 1024)),
+            device_(new osgLeap::PointerEventDevice(osgLeap::PointerEventDevice::TIMEBASED_MOUSECLICK,
+                osgLeap::PointerEventDevice::MOUSE, 3600000, listener_.get())) {}
+
+    protected:
+        virtual void step() { device_->checkEvents(); }
+        virtual unsigned int takeEvents() { return drainEvents(device_->getEventQueue()); }
+        virtual unsigned int takeChanges() { return pointerChanges(listener_.get()); }
+
+    private:
+        osg::ref_ptr<osgLeap::PointerPositionListener> listener_;
+        osg::ref_ptr<osgLeap::PointerEventDevice> device_;
+    };
+
+    class DeviceComponent: public Component {
+    public:
+        DeviceComponent(unsigned int eventCost): Component("Device::checkEvents", eventCost),
+            device_(new osgLeap::Device()) {}
+
+    protected:
+        virtual void step() { device_->checkEvents(); }
+        virtual unsigned int takeEvents() { return drainEvents(device_->getEventQueue()); }
+
+    private:
+        osg::ref_ptr<osgLeap::Device> device_;
+    };
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || (std::strcmp(argv[1], "hover") != 0 && std::strcmp(argv[1], "dwell") != 0 && std::strcmp(argv[1], "churn") != 0)) {
+        std::cerr<<"Usage: "<<argv[0]<<" <hover|dwell|churn>"<<std::endl;
+        return 2;
+    }
+    // Clicks and dwell progress fire in the dwell scenario
+    const int dwellTime = (std::strcmp(argv[1], "dwell") == 0) ? 300 : 0;
+
+    std::vector<Component*> components;
+    components.push_back(new ListenerComponent(dwellTime));
+    components.push_back(new GraphicsComponent(dwellTime));
+    components.push_back(new EventDeviceComponent(newEventCost()));
+    components.push_back(new DeviceComponent(queueCost()));
+
+    // Once per tracking frame
+    Leap::Controller controller;
+    long long lastID = -1;
+    for (unsigned int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; ++frame) {
+        while (controller.frame().id() == lastID) {
+            OpenThreads::Thread::microSleep(100);
+        }
+        lastID = controller.frame().id();
+        for (std::vector<Component*>::iterator itr = components.begin(); itr != components.end(); ++itr) {
+            (*itr)->run(frame >= WARMUP_FRAMES);
+        }
+    }
+
+    bool ok = true;
+    std::cout<<"Scenario "<<argv[1]<<std::endl;
+    for (std::vector<Component*>::iterator itr = components.begin(); itr != components.end(); ++itr) {
+        if (!(*itr)->report()) ok = false;
+        delete *itr;
+    }
+
+    std::cout<<(ok ? "Passed" : "FAILED")<<std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+* Test dwellengine
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Replays scripted pointer positions through DwellEngine with fixed
+// timestamps and checks when clicks fire: after the dwell time at rest,
+// again one dwell time later, not when jitter stays within the radius plus
+// hysteresis, one dwell time after the pointer left it, and never for a
+// drifting pointer. Every script is replayed with frames 10 ms and 100 ms
+// apart, both have to click at the same times.
+
+#include <osgLeap/DwellEngine>
+
+#include <osg/ref_ptr>
+#include <osg/Vec2>
+
+#include <iostream>
+#include <vector>
+
+namespace {
+
+    // The pointer is at x (pixels) from time (ms) until the next key, or
+    // drifts there linearly
+    struct Key {
+        long long time;
+        float x;
+    };
+
+    float xAt(const Key* keys, unsigned int numKeys, long long time, bool drift)
+    {
+        for (unsigned int i = numKeys-1; i > 0; --i) {
+            if (time >= keys[i].time*1000) return keys[i].x;
+            if (drift && time >= keys[i-1].time*1000) {
+                const float f = (float)(time - keys[i-1].time*1000)/(float)((keys[i].time - keys[i-1].time)*1000);
+                return keys[i-1].x + f*(keys[i].x - keys[i-1].x);
+            }
+        }
+        return keys[0].x;
+    }
+
+    // Advances a pointer every spacing microseconds up to the last key
+    // and returns the times of the clicks in milliseconds
+    std::vector<long long> replay(const osgLeap::DwellEngine* engine, const Key* keys, unsigned int numKeys,
+        long long spacing, bool drift = false)
+    {
+        osgLeap::DwellEngine::State state;
+        std::vector<long long> clicks;
+        for (long long t = 0; t <= keys[numKeys-1].time*1000; t += spacing) {
+            if (engine->advance(state, osg::Vec2(xAt(keys, numKeys, t, drift), 100.0f), t)) clicks.push_back(t/1000);
+        }
+        return clicks;
+    }
+
+    bool clicksAt(const std::vector<long long>& clicks, long long first, long long second = -1)
+    {
+        if (clicks.size() != (second < 0 ? 1u : 2u)) return false;
+        return clicks[0] == first && (second < 0 || clicks[1] == second);
+    }
+
+    bool check(bool condition, const char* what)
+    {
+        if (!condition) std::cerr<<"FAILED: "<<what<<std::endl;
+        return condition;
+    }
+
+}
+
+int main(int, char**)
+{
+    bool ok = true;
+
+    // 500 ms dwell time, 20 pixels radius plus 5 pixels hysteresis
+    osg::ref_ptr<osgLeap::DwellEngine> engine = new osgLeap::DwellEngine();
+    engine->setDwellTime(500);
+
+    // Resting for 1.2 s
+    const Key rest[] = { {0, 100.0f}, {1200, 100.0f} };
+    // Jumping to 24 pixels from where the dwell started and back: within
+    // radius plus hysteresis
+    const Key jitter[] = { {0, 100.0f}, {200, 124.0f}, {300, 100.0f}, {800, 100.0f} };
+    // Jumping to 26 pixels and staying there: the dwell starts over
+    const Key leave[] = { {0, 100.0f}, {200, 126.0f}, {800, 126.0f} };
+    // Drifting at 100 pixels per second
+    const Key drift[] = { {0, 100.0f}, {1500, 250.0f} };
+
+    const long long spacings[] = { 10000, 100000 };
+    for (unsigned int s = 0; s < 2; ++s) {
+        const long long spacing = spacings[s];
+        std::cout<<"Frames "<<spacing/1000<<" ms apart"<<std::endl;
+
+        const std::vector<long long> restClicks = replay(engine.get(), rest, 2, spacing);
+        std::cout<<"  Resting: "<<restClicks.size()<<" clicks"<<std::endl;
+        ok = check(clicksAt(restClicks, 500, 1000), "clicks at 500 and 1000 ms at rest") && ok;
+
+        ok = check(clicksAt(replay(engine.get(), jitter, 4, spacing), 500), "jitter within the hysteresis keeps the dwell") && ok;
+        ok = check(clicksAt(replay(engine.get(), leave, 3, spacing), 700), "dwell starts over beyond the hysteresis") && ok;
+        ok = check(replay(engine.get(), drift, 2, spacing, true).empty(), "no click while drifting") && ok;
+    }
+
+    // The hysteresis applies once a dwell is under way only: 24 pixels
+    // off with the second frame already leave the radius
+    {
+        osgLeap::DwellEngine::State state;
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 0);
+        engine->advance(state, osg::Vec2(124.0f, 100.0f), 10000);
+        ok = check(!state.dwelling && state.startTime == 10000 && state.anchor.x() == 124.0f,
+            "radius without hysteresis before the dwell") && ok;
+        // Back and resting for a frame, then 24 pixels off again
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 20000);
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 30000);
+        engine->advance(state, osg::Vec2(124.0f, 100.0f), 40000);
+        ok = check(state.dwelling && state.startTime == 20000, "hysteresis during the dwell") && ok;
+    }
+
+    // Progress grows with the frame timestamps, stale frames are ignored
+    {
+        osgLeap::DwellEngine::State state;
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 1000000);
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 1250000);
+        ok = check(state.progress == 0.5f, "half way after 250 ms") && ok;
+        engine->advance(state, osg::Vec2(100.0f, 100.0f), 1100000);
+        ok = check(state.progress == 0.5f && state.timestamp == 1250000, "older frame ignored") && ok;
+    }
+
+    std::cout<<(ok ? "Passed" : "FAILED")<<std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/*
+* Test framemailbox
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Hammers TripleBuffer and FrameMailbox from two threads. Built with
+// -fsanitize=thread where available, so ThreadSanitizer reports any race on
+// the buffers; the checks below catch torn or out of order values.
+
+#include <osgLeap/AtomicIndex>
+#include <osgLeap/FrameMailbox>
+#include <osgLeap/TripleBuffer>
+
+#include <OpenThreads/Thread>
+
+#include <Leap.h>
+
+#include <iostream>
+
+namespace {
+
+    const unsigned int NUM_VALUES = 200000;
+    const unsigned int NUM_FRAMES = 20000;
+
+    // Large enough that copying it is not atomic by accident
+    struct Payload {
+        Payload(): sequence(0) { for (unsigned int i = 0; i < 64; ++i) values[i] = 0; }
+
+        unsigned int sequence;
+        unsigned int values[64];
+    };
+
+    class Writer: public OpenThreads::Thread {
+    public:
+        Writer(osgLeap::TripleBuffer<Payload>& buffer): buffer_(buffer) {}
+
+        virtual void run()
+        {
+            for (unsigned int sequence = 1; sequence <= NUM_VALUES; ++sequence) {
+                Payload& payload = buffer_.getWriteBuffer();
+                payload.sequence = sequence;
+                for (unsigned int i = 0; i < 64; ++i) payload.values[i] = sequence*(i+1);
+                buffer_.publish();
+            }
+            done.store(1);
+        }
+
+        osgLeap::AtomicIndex done;
+
+    private:
+        osgLeap::TripleBuffer<Payload>& buffer_;
+    };
+
+    // The shim's service thread posts every frame
+    class Poster: public Leap::Listener {
+    public:
+        virtual void onFrame(const Leap::Controller& controller) { mailbox.post(controller.frame()); }
+
+        osgLeap::FrameMailbox mailbox;
+    };
+
+    bool checkPayload(const Payload& payload, unsigned int lastSequence)
+    {
+        if (payload.sequence <= lastSequence) {
+            std::cerr<<"TripleBuffer: sequence "<<payload.sequence<<" after "<<lastSequence<<std::endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < 64; ++i) {
+            if (payload.values[i] != payload.sequence*(i+1)) {
+                std::cerr<<"TripleBuffer: torn value in sequence "<<payload.sequence<<std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool testTripleBuffer()
+    {
+        osgLeap::TripleBuffer<Payload> buffer;
+        Writer writer(buffer);
+        writer.start();
+
+        unsigned int lastSequence = 0;
+        unsigned int numRead = 0;
+        bool ok = true;
+        for (;;) {
+            // Check done before update, so the last value is picked up
+            const bool done = writer.done.load() != 0;
+            if (buffer.update()) {
+                ok = ok && checkPayload(buffer.getReadBuffer(), lastSequence);
+                lastSequence = buffer.getReadBuffer().sequence;
+                ++numRead;
+            }
+            if (done) break;
+        }
+        writer.join();
+
+        if (lastSequence != NUM_VALUES) {
+            std::cerr<<"TripleBuffer: last value "<<lastSequence<<" instead of "<<NUM_VALUES<<std::endl;
+            ok = false;
+        }
+        std::cout<<"TripleBuffer: "<<numRead<<" of "<<NUM_VALUES<<" values read"<<std::endl;
+        return ok;
+    }
+
+    bool testFrameMailbox()
+    {
+        Poster poster;
+        Leap::Controller controller(poster);
+
+        long long lastID = -1;
+        long long lastTimestamp = -1;
+        unsigned int numFetched = 0;
+        bool ok = true;
+        while (ok && lastID < (long long)NUM_FRAMES) {
+            const Leap::Frame& frame = poster.mailbox.fetch();
+            if (!frame.isValid() || frame.id() == lastID) {
+                OpenThreads::Thread::YieldCurrentThread();
+                continue;
+            }
+            if (frame.id() < lastID || frame.timestamp() <= lastTimestamp) {
+                std::cerr<<"FrameMailbox: frame "<<frame.id()<<" after "<<lastID<<std::endl;
+                ok = false;
+            }
+            // The scripted hand of the shim
+            if (frame.hands().count() != 1 || frame.fingers().count() != 5 ||
+                frame.hands()[0].fingers().extended().count() != 1) {
+                std::cerr<<"FrameMailbox: unexpected content in frame "<<frame.id()<<std::endl;
+                ok = false;
+            }
+            lastID = frame.id();
+            lastTimestamp = frame.timestamp();
+            ++numFetched;
+        }
+        controller.removeListener(poster);
+
+        std::cout<<"FrameMailbox: "<<numFetched<<" of "<<lastID<<" frames fetched"<<std::endl;
+        return ok;
+    }
+
+}
+
+int main(int, char**)
+{
+    bool ok = testTripleBuffer();
+    ok = testFrameMailbox() && ok;
+    return ok ? 0 : 1;
+}
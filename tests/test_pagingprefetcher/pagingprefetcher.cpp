@@ -0,0 +1,240 @@
+/*
+* Test pagingprefetcher
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Counts the pager requests PagingPrefetcher sends for a synthetic row of
+// PagedLOD tiles while the manipulator pans along it, checks that a tile
+// with three levels is refined one level at a time, and checks the
+// predicted path against the manipulator's own movements.
+
+#include <osgLeap/OrbitManipulator>
+#include <osgLeap/PagingPrefetcher>
+
+#include <osg/Camera>
+#include <osg/FrameStamp>
+#include <osg/Geode>
+#include <osg/Group>
+#include <osg/PagedLOD>
+#include <osg/ShapeDrawable>
+
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+    const unsigned int NUM_TILES = 10;
+    // Tiles are 100 apart along x, their high resolution child is needed
+    // within 150 of the eye
+    const float TILE_SPACING = 100.0f;
+    const float TILE_RANGE = 150.0f;
+
+    // Records the requests instead of loading anything
+    class CountingRequestHandler: public osg::NodeVisitor::DatabaseRequestHandler {
+    public:
+        virtual void requestNodeFile(const std::string& fileName, osg::NodePath& /*nodePath*/, float /*priority*/,
+            const osg::FrameStamp* /*framestamp*/, osg::ref_ptr<osg::Referenced>& /*databaseRequest*/,
+            const osg::Referenced* /*options*/)
+        {
+            fileNames.insert(fileName);
+            ++numRequests;
+        }
+
+        CountingRequestHandler(): numRequests(0) {}
+
+        std::multiset<std::string> fileNames;
+        unsigned int numRequests;
+    };
+
+    // Lets the test drive the action and palm velocity the events would set
+    class TestManipulator: public osgLeap::OrbitManipulator {
+    public:
+        TestManipulator(Mode mode): osgLeap::OrbitManipulator(mode) {}
+
+        void setMotion(int action, const osg::Vec3& palmVelocity)
+        {
+            currentAction_ = action;
+            palmVelocity_ = palmVelocity;
+            panScale_ = 1000.0;
+        }
+
+        // What getPredictedPath extrapolates, using the manipulator itself
+        void stepLikeSingleHanded(const osg::Vec3& movement, bool pan)
+        {
+            if (pan) {
+                panModel(-movement.x(), -movement.y());
+            } else {
+                rotateWithFixedVertical(movement.x()/100.0f, movement.y()/100.0f);
+                zoomModel(-movement.z()/100.0f);
+            }
+        }
+    };
+
+    std::string tileName(unsigned int i)
+    {
+        std::ostringstream name;
+        name<<"tile_"<<i<<".osgt";
+        return name.str();
+    }
+
+    // A row of PagedLODs along x, each with its low resolution child loaded
+    osg::ref_ptr<osg::Group> createTiles()
+    {
+        osg::ref_ptr<osg::Group> root = new osg::Group();
+        for (unsigned int i = 0; i < NUM_TILES; ++i) {
+            osg::ref_ptr<osg::Geode> lowRes = new osg::Geode();
+            lowRes->addDrawable(new osg::ShapeDrawable(new osg::Box(osg::Vec3(i*TILE_SPACING, 0.0f, 0.0f), 10.0f)));
+
+            osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD();
+            plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+            plod->setCenter(osg::Vec3(i*TILE_SPACING, 0.0f, 0.0f));
+            plod->setRadius(TILE_SPACING*0.5f);
+            plod->setRangeMode(osg::LOD::DISTANCE_FROM_EYE_POINT);
+            plod->addChild(lowRes.get(), TILE_RANGE, 1e10f);
+            plod->setFileName(1, tileName(i));
+            plod->setRange(1, 0.0f, TILE_RANGE);
+            root->addChild(plod.get());
+        }
+        return root;
+    }
+
+    std::string levelName(unsigned int level)
+    {
+        std::ostringstream name;
+        name<<"deep_"<<level<<".osgt";
+        return name.str();
+    }
+
+    osg::ref_ptr<osg::Geode> createBox(float size)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+        geode->addDrawable(new osg::ShapeDrawable(new osg::Box(osg::Vec3(0.0f, 0.0f, 0.0f), size)));
+        return geode;
+    }
+
+    // A tile at the origin with three levels: level 0 is loaded and used
+    // beyond 150, level 1 from 50 to 150 and level 2 below 50
+    osg::ref_ptr<osg::PagedLOD> createDeepTile()
+    {
+        osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD();
+        plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+        plod->setCenter(osg::Vec3(0.0f, 0.0f, 0.0f));
+        plod->setRadius(TILE_SPACING*0.5f);
+        plod->setRangeMode(osg::LOD::DISTANCE_FROM_EYE_POINT);
+        plod->addChild(createBox(10.0f).get(), TILE_RANGE, 1e10f);
+        plod->setFileName(1, levelName(1));
+        plod->setRange(1, 50.0f, TILE_RANGE);
+        plod->setFileName(2, levelName(2));
+        plod->setRange(2, 0.0f, 50.0f);
+        return plod;
+    }
+
+    bool check(bool condition, const char* what)
+    {
+        if (!condition) std::cerr<<"FAILED: "<<what<<std::endl;
+        return condition;
+    }
+
+    bool equal(const osg::Matrixd& a, const osg::Matrixd& b)
+    {
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                if (fabs(a(r, c)-b(r, c)) > 1e-6*(1.0+fabs(a(r, c)))) return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+int main(int, char**)
+{
+    bool ok = true;
+
+    osg::ref_ptr<osg::Group> tiles = createTiles();
+    osg::ref_ptr<osg::Camera> camera = new osg::Camera();
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp();
+
+    // Looking down onto tile 0 from 100 above: tiles 0 and 1 are in range
+    osg::ref_ptr<TestManipulator> manipulator = new TestManipulator(osgLeap::OrbitManipulator::SingleHanded);
+    manipulator->setTransformation(osg::Vec3d(0.0, 0.0, 100.0), osg::Vec3d(0.0, 0.0, 0.0), osg::Vec3d(0.0, 1.0, 0.0));
+
+    osg::ref_ptr<osgLeap::PagingPrefetcher> prefetcher = new osgLeap::PagingPrefetcher(manipulator.get(), camera.get());
+    prefetcher->setHorizon(0.3);
+    prefetcher->setNumSteps(3);
+
+    // No action, no prediction, no requests
+    {
+        osg::ref_ptr<CountingRequestHandler> handler = new CountingRequestHandler();
+        prefetcher->prefetch(tiles.get(), handler.get(), frameStamp.get());
+        ok = check(handler->numRequests == 0, "no requests without an action") && ok;
+    }
+
+    // Panning at 1 m/s to the left moves the camera 100 to the right per
+    // step (0.1 s): the steps need tiles 0-2, 1-3 and 2-4
+    {
+        manipulator->setModifierState(true);
+        manipulator->setMotion(osgLeap::OrbitManipulator::LM_Pan, osg::Vec3(-1000.0f, 0.0f, 0.0f));
+        osg::ref_ptr<CountingRequestHandler> handler = new CountingRequestHandler();
+        prefetcher->prefetch(tiles.get(), handler.get(), frameStamp.get());
+
+        std::cout<<"Panning: "<<handler->numRequests<<" requests"<<std::endl;
+        ok = check(handler->numRequests == 9, "nine requests along the pan") && ok;
+        ok = check(prefetcher->getNumRequests() == 9, "requests counted by the prefetcher") && ok;
+        ok = check(handler->fileNames.count(tileName(2)) == 3 && handler->fileNames.count(tileName(3)) == 2
+            && handler->fileNames.count(tileName(4)) == 1, "tiles ahead requested") && ok;
+        ok = check(handler->fileNames.count(tileName(5)) == 0, "no tiles beyond the horizon") && ok;
+    }
+
+    // Close to a tile with three levels, level 2 is in range but level 1
+    // is requested first: the pager attaches whatever it loads as the next
+    // child, as osg::PagedLOD::traverse expects
+    {
+        osg::ref_ptr<osg::PagedLOD> deep = createDeepTile();
+        manipulator->setTransformation(osg::Vec3d(0.0, 0.0, 20.0), osg::Vec3d(0.0, 0.0, 0.0), osg::Vec3d(0.0, 1.0, 0.0));
+        manipulator->setModifierState(true);
+        manipulator->setMotion(osgLeap::OrbitManipulator::LM_Pan, osg::Vec3(-1.0f, 0.0f, 0.0f));
+
+        osg::ref_ptr<CountingRequestHandler> handler = new CountingRequestHandler();
+        prefetcher->prefetch(deep.get(), handler.get(), frameStamp.get());
+        std::cout<<"Three levels, level 0 loaded: "<<handler->numRequests<<" requests"<<std::endl;
+        ok = check(handler->fileNames.count(levelName(1)) == 3, "next level requested") && ok;
+        ok = check(handler->fileNames.count(levelName(2)) == 0, "no level beyond the next one") && ok;
+
+        // Once level 1 has been attached, level 2 is next
+        deep->addChild(createBox(5.0f).get(), 50.0f, TILE_RANGE);
+        handler = new CountingRequestHandler();
+        prefetcher->prefetch(deep.get(), handler.get(), frameStamp.get());
+        std::cout<<"Three levels, levels 0 and 1 loaded: "<<handler->numRequests<<" requests"<<std::endl;
+        ok = check(handler->fileNames.count(levelName(2)) == 3 && handler->numRequests == 3, "last level requested") && ok;
+    }
+
+    // The predicted path follows the manipulator's own movements
+    for (int pan = 0; pan <= 1; ++pan) {
+        const osg::Vec3 velocity(-400.0f, 250.0f, 300.0f);
+        manipulator->setTransformation(osg::Vec3d(0.0, -50.0, 100.0), osg::Vec3d(0.0, 0.0, 0.0), osg::Vec3d(0.0, 0.0, 1.0));
+        manipulator->setModifierState(pan != 0);
+        manipulator->setMotion(pan != 0 ? osgLeap::OrbitManipulator::LM_Pan : (osgLeap::OrbitManipulator::LM_Rotate | osgLeap::OrbitManipulator::LM_Zoom), velocity);
+
+        std::vector<osg::Matrixd> path;
+        manipulator->getPredictedPath(0.3, 3, path);
+
+        osg::ref_ptr<TestManipulator> reference = new TestManipulator(*manipulator);
+        bool same = (path.size() == 3);
+        for (unsigned int i = 0; same && i < path.size(); ++i) {
+            reference->stepLikeSingleHanded(velocity*0.1f, pan != 0);
+            same = equal(path[i], reference->getMatrix());
+        }
+        ok = check(same, pan != 0 ? "predicted pan" : "predicted rotation and zoom") && ok;
+    }
+
+    std::cout<<(ok ? "Passed" : "FAILED")<<std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+/*
+* Test sensorimagestream
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Replays synthetic camera images through SensorImageStream::pushImage and
+// update() and checks the uploaded pixels with and without decimation,
+// that updates without a new image upload nothing, that images arriving
+// between two updates are counted as dropped, and that the textures keep
+// their image and its data from one upload to the next. The shim delivers
+// no sensor images, so pushImage is the only writer.
+
+#include <osgLeap/SensorImageStream>
+
+#include <osg/Image>
+#include <osg/Texture2D>
+
+#include <iostream>
+#include <vector>
+
+namespace {
+
+    // width x height pixels with value x*dx+y*dy+offset
+    std::vector<unsigned char> createImage(int width, int height, int dx, int dy, int offset)
+    {
+        std::vector<unsigned char> data(width*height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                data[y*width+x] = (unsigned char)(x*dx+y*dy+offset);
+            }
+        }
+        return data;
+    }
+
+    bool equals(const osg::Image* image, const std::vector<unsigned char>& data)
+    {
+        if ((unsigned int)(image->s()*image->t()) != data.size()) return false;
+        for (unsigned int i = 0; i < data.size(); ++i) {
+            if (image->data()[i] != data[i]) return false;
+        }
+        return true;
+    }
+
+    bool check(bool condition, const char* what)
+    {
+        if (!condition) std::cerr<<"FAILED: "<<what<<std::endl;
+        return condition;
+    }
+
+}
+
+int main(int, char**)
+{
+    bool ok = true;
+
+    osg::ref_ptr<osgLeap::SensorImageStream> stream = new osgLeap::SensorImageStream();
+
+    // Nothing pushed yet, nothing to upload
+    ok = check(!stream->update() && stream->getNumUploads() == 0, "no upload without an image") && ok;
+
+    // The first image allocates the texture's image
+    const std::vector<unsigned char> first = createImage(8, 4, 3, 20, 1);
+    stream->pushImage(0, 8, 4, &first[0]);
+    ok = check(stream->update() && stream->getNumUploads() == 1, "first image uploaded") && ok;
+    osg::Image* image = stream->getImage(0);
+    ok = check(image->s() == 8 && image->t() == 4 && equals(image, first), "first image copied") && ok;
+    ok = check(stream->getTexture(0)->getImage() == image, "texture uses the stream's image") && ok;
+
+    // Further images of the same size are copied into the same memory
+    const unsigned char* data = image->data();
+    const unsigned int modified = image->getModifiedCount();
+    const std::vector<unsigned char> second = createImage(8, 4, 5, 7, 2);
+    stream->pushImage(0, 8, 4, &second[0]);
+    ok = check(stream->update() && stream->getNumUploads() == 2, "second image uploaded") && ok;
+    ok = check(stream->getImage(0) == image && stream->getTexture(0)->getImage() == image,
+        "texture keeps its image") && ok;
+    ok = check(image->data() == data && equals(image, second), "second image copied without reallocation") && ok;
+    ok = check(image->getModifiedCount() == modified+1, "image dirtied once") && ok;
+
+    // Frames without a new image upload nothing and leave the image clean
+    for (unsigned int i = 0; i < 3; ++i) {
+        ok = check(!stream->update(), "update without a new image") && ok;
+    }
+    ok = check(stream->getNumUploads() == 2 && image->getModifiedCount() == modified+1, "no upload skipped frames") && ok;
+
+    // Two images before the next update: the older one is dropped
+    const std::vector<unsigned char> dropped = createImage(8, 4, 1, 1, 100);
+    const std::vector<unsigned char> kept = createImage(8, 4, 2, 2, 50);
+    stream->pushImage(1, 8, 4, &dropped[0]);
+    stream->pushImage(1, 8, 4, &kept[0]);
+    ok = check(stream->update() && stream->getNumUploads() == 3 && stream->getNumDropped() == 1, "older image dropped") && ok;
+    ok = check(equals(stream->getImage(1), kept), "newer image uploaded") && ok;
+    ok = check(equals(stream->getImage(0), second), "other camera unchanged") && ok;
+
+    // Decimation by 2 averages 2 x 2 blocks and drops the incomplete last
+    // column: block (x, y) averages to 20*x+80*y+25
+    stream->setDecimation(2);
+    const std::vector<unsigned char> large = createImage(5, 4, 10, 40, 0);
+    stream->pushImage(0, 5, 4, &large[0]);
+    ok = check(stream->update() && stream->getImage(0) == image, "decimated image uploaded") && ok;
+    ok = check(image->s() == 2 && image->t() == 2, "decimated size") && ok;
+    ok = check(image->data()[0] == 25 && image->data()[1] == 45 && image->data()[2] == 105 && image->data()[3] == 125,
+        "decimated pixels averaged") && ok;
+
+    // The new size is kept as long as the images do not change
+    data = image->data();
+    const std::vector<unsigned char> larger = createImage(5, 4, 10, 40, 4);
+    stream->pushImage(0, 5, 4, &larger[0]);
+    ok = check(stream->update() && image->data() == data && image->data()[0] == 29, "decimated image without reallocation") && ok;
+    ok = check(stream->getNumUploads() == 5 && stream->getNumDropped() == 1, "uploads and drops counted") && ok;
+
+    std::cout<<(ok ? "Passed" : "FAILED")<<std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+/*
+* Test tapdetector
+* Copyright (C) 2013 Johannes Kroeger/vtxtech. All rights reserved.
+*
+* This file is licensed under the GNU Lesser General Public License 3 (LGPLv3),
+* but distributed WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+*/
+
+// Replays scripted fingertip strokes through TapDetector with fixed
+// timestamps and checks when taps fire: on the forward stroke, once per
+// stroke while the velocity stays between the release and the press
+// velocity, not during the refractory time, and not for strokes below the
+// press velocity. Every script is replayed with samples 1 ms and 10 ms
+// apart, both have to give the same taps.
+
+#include <osgLeap/TapDetector>
+
+#include <osg/ref_ptr>
+#include <osg/Vec3>
+
+#include <iostream>
+#include <vector>
+
+namespace {
+
+    // Depth of the fingertip towards the screen (mm) at a time (ms), the
+    // tip moves linearly from one key to the next
+    struct Key {
+        long long time;
+        float depth;
+    };
+
+    float depthAt(const Key* keys, unsigned int numKeys, long long time)
+    {
+        if (time <= keys[0].time*1000) return keys[0].depth;
+        for (unsigned int i = 1; i < numKeys; ++i) {
+            if (time <= keys[i].time*1000) {
+                const float f = (float)(time - keys[i-1].time*1000)/(float)((keys[i].time - keys[i-1].time)*1000);
+                return keys[i-1].depth + f*(keys[i].depth - keys[i-1].depth);
+            }
+        }
+        return keys[numKeys-1].depth;
+    }
+
+    // Samples the script every spacing microseconds up to its last key
+    // and returns the timestamps of the taps
+    std::vector<long long> replay(const osgLeap::TapDetector* detector, const Key* keys, unsigned int numKeys, long long spacing)
+    {
+        // Screen normal towards the user, the tip moves against it
+        const osg::Vec3 normal(0.0f, 0.0f, 1.0f);
+        osgLeap::TapDetector::State state;
+        std::vector<long long> taps;
+        for (long long t = 0; t <= keys[numKeys-1].time*1000; t += spacing) {
+            if (detector->update(state, osg::Vec3(0.0f, 0.0f, -depthAt(keys, numKeys, t)), t, normal)) taps.push_back(t);
+        }
+        return taps;
+    }
+
+    // True if there is one tap per stroke and each one fired while its
+    // stroke was still moving forward, between begin and end (ms)
+    bool tapsWithin(const std::vector<long long>& taps, const long long (*strokes)[2], unsigned int numStrokes)
+    {
+        if (taps.size() != numStrokes) return false;
+        for (unsigned int i = 0; i < numStrokes; ++i) {
+            if (taps[i] <= strokes[i][0]*1000 || taps[i] > strokes[i][1]*1000) return false;
+        }
+        return true;
+    }
+
+    bool check(bool condition, const char* what)
+    {
+        if (!condition) std::cerr<<"FAILED: "<<what<<std::endl;
+        return condition;
+    }
+
+}
+
+int main(int, char**)
+{
+    bool ok = true;
+
+    // Defaults: press at 300 mm/s, release at 100 mm/s, 8 mm travel,
+    // 150 ms refractory time
+    osg::ref_ptr<osgLeap::TapDetector> detector = new osgLeap::TapDetector();
+    osg::ref_ptr<osgLeap::TapDetector> noRefractory = new osgLeap::TapDetector();
+    noRefractory->setRefractoryTime(0);
+
+    // One stroke at 400 mm/s from 100 to 160 ms, the finger stays in
+    // front. The SDK's screen tap would need it to come back.
+    const Key single[] = { {0, 0.0f}, {100, 0.0f}, {160, 24.0f}, {400, 24.0f} };
+    const long long singleStrokes[][2] = { {100, 160} };
+
+    // Three such strokes; the second begins 40 ms after the first one
+    // stopped, within the refractory time
+    const Key triple[] = { {0, 0.0f}, {100, 0.0f}, {160, 24.0f}, {200, 24.0f}, {260, 48.0f},
+        {400, 48.0f}, {460, 72.0f}, {600, 72.0f} };
+    const long long tripleStrokes[][2] = { {100, 160}, {200, 260}, {400, 460} };
+    const long long refractoryStrokes[][2] = { {100, 160}, {400, 460} };
+
+    // A stroke slowing down from 400 to 150 mm/s for 100 ms and speeding
+    // up again: between release and press velocity it stays one stroke
+    const Key slowing[] = { {0, 0.0f}, {100, 0.0f}, {200, 40.0f}, {300, 55.0f}, {400, 95.0f}, {600, 95.0f} };
+    const long long slowingStrokes[][2] = { {100, 200} };
+
+    // A push at 250 mm/s for 200 ms never reaches the press velocity
+    const Key push[] = { {0, 0.0f}, {100, 0.0f}, {300, 50.0f}, {500, 50.0f} };
+
+    const long long spacings[] = { 1000, 10000 };
+    std::vector<long long> taps[2];
+    for (unsigned int s = 0; s < 2; ++s) {
+        const long long spacing = spacings[s];
+        std::cout<<"Samples "<<spacing/1000<<" ms apart"<<std::endl;
+
+        taps[s] = replay(detector.get(), single, 4, spacing);
+        std::cout<<"  Single stroke: "<<taps[s].size()<<" taps"<<(taps[s].empty() ? "" : ", first at ")
+            <<(taps[s].empty() ? 0 : taps[s][0]/1000)<<" ms"<<std::endl;
+        ok = check(tapsWithin(taps[s], singleStrokes, 1), "tap on the forward stroke") && ok;
+
+        std::vector<long long> tripleTaps = replay(detector.get(), triple, 8, spacing);
+        std::cout<<"  Three strokes: "<<tripleTaps.size()<<" taps"<<std::endl;
+        ok = check(tapsWithin(tripleTaps, refractoryStrokes, 2), "no tap during the refractory time") && ok;
+        tripleTaps = replay(noRefractory.get(), triple, 8, spacing);
+        ok = check(tapsWithin(tripleTaps, tripleStrokes, 3), "three taps without refractory time") && ok;
+
+        const std::vector<long long> slowingTaps = replay(detector.get(), slowing, 6, spacing);
+        std::cout<<"  Slowing stroke: "<<slowingTaps.size()<<" taps"<<std::endl;
+        ok = check(tapsWithin(slowingTaps, slowingStrokes, 1), "one tap while above the release velocity") && ok;
+
+        const std::vector<long long> pushTaps = replay(detector.get(), push, 4, spacing);
+        ok = check(pushTaps.empty(), "no tap below the press velocity") && ok;
+    }
+
+    // Ten times fewer samples fire the same tap at most one sample later
+    ok = check(taps[0].size() == 1 && taps[1].size() == 1 && taps[1][0] >= taps[0][0]
+        && taps[1][0] - taps[0][0] <= spacings[1], "same tap at 1 ms and 10 ms") && ok;
+
+    std::cout<<(ok ? "Passed" : "FAILED")<<std::endl;
+    return ok ? 0 : 1;
+}